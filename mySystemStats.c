@@ -8,230 +8,3238 @@
 #include <utmp.h>
 #include <getopt.h>
 #include <math.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <endian.h>
 
 
+// how screen_flush puts a frame on the terminal
+enum screen_mode {
+    SCREEN_APPEND, //writes the frame below the previous one (sequential mode)
+    SCREEN_REDRAW, //clears the screen and writes the whole frame
+    SCREEN_DIFF //rewrites only the lines that differ from the frame on the terminal
+};
+
+// a frame being assembled, the frame currently on the terminal, and the output sent to the terminal
+struct screen {
+    int fd; //file descriptor the frames are written to
+    enum screen_mode mode;
+    char *buf; size_t len, cap; //the frame being assembled by frame_printf
+    char *prev; size_t prev_len, prev_cap; //the frame drawn by the previous flush
+    char *out; size_t out_len, out_cap; //bytes of the next write(2)
+    int drawn; //whether a frame has been drawn yet
+    long long bytes; //total number of bytes written
+    int height; //rows of the terminal at the latest full redraw, 0 if fd is not a terminal (no clipping)
+};
+
+struct screen term = {STDOUT_FILENO, SCREEN_DIFF, NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, 0, 0, 0}; //the frame printed by the sampling loop
+atomic_int term_resized = 0; //set by the SIGWINCH handler, the next diff flush measures the terminal again and redraws everything
+
+// signal handler for SIGWINCH: the lines on the terminal no longer match the previous frame
+void note_resize(int sig){
+    (void)sig;
+    term_resized = 1;
+}
+
+// returns the number of rows of the terminal sc writes to, or 0 if it is not a terminal
+int screen_height(const struct screen *sc){
+    struct winsize ws;
+    if(ioctl(sc->fd, TIOCGWINSZ, &ws) < 0 || ws.ws_row == 0) return 0;
+    return ws.ws_row;
+}
+
+// makes sure *buf has room for need bytes, doubling its size as needed; exits the program if memory runs out
+void grow_buffer(char **buf, size_t *cap, size_t need){
+    if(need <= *cap) return;
+    size_t cap2 = *cap ? *cap : 4096;
+    while(cap2 < need) cap2 *= 2;
+    char *bigger = realloc(*buf, cap2);
+    if(bigger == NULL){
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    *buf = bigger;
+    *cap = cap2;
+}
+
+// appends n bytes of data to the output of the next write
+void screen_emit(struct screen *sc, const char *data, size_t n){
+    grow_buffer(&sc->out, &sc->out_cap, sc->out_len + n);
+    memcpy(sc->out + sc->out_len, data, n);
+    sc->out_len += n;
+}
+
+// appends the escape sequence that moves the cursor to the first column of the given 1-based row
+void screen_goto(struct screen *sc, int row){
+    char seq[32];
+    int n = snprintf(seq, sizeof seq, "\033[%d;1H", row);
+    screen_emit(sc, seq, n);
+}
+
+// same as frame_printf, with the arguments in a va_list
+void frame_vprintf(const char *fmt, va_list args){
+    va_list ap;
+    for(;;){
+        size_t room = term.cap - term.len;
+        va_copy(ap, args);
+        int n = vsnprintf(term.buf ? term.buf + term.len : NULL, room, fmt, ap); //formats straight into the frame buffer
+        va_end(ap);
+        if(n < 0) return;
+        if((size_t)n < room){
+            term.len += n;
+            return;
+        }
+        grow_buffer(&term.buf, &term.cap, term.len + n + 1); //the text did not fit, so the buffer is grown and the text formatted again
+    }
+}
+
+// formats text like printf and appends it to the frame being assembled instead of printing it
+void frame_printf(const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    frame_vprintf(fmt, ap);
+    va_end(ap);
+}
+
+// appends n bytes to the frame being assembled, without formatting
+void frame_write(const char *data, size_t n){
+    grow_buffer(&term.buf, &term.cap, term.len + n + 1);
+    memcpy(term.buf + term.len, data, n);
+    term.len += n;
+}
+
+/*  puts the assembled frame on the terminal with a single write(2) and starts a new frame.
+ *   in SCREEN_DIFF mode the frame is compared line by line with the previous one, and only the lines that
+ *   changed are rewritten, each preceded by a cursor-positioning escape and followed by an erase-to-end-of-line.
+ *   Lines below the bottom of the terminal are not drawn, since absolute positioning cannot reach them.
+ */
+void screen_flush(struct screen *sc){
+    sc->out_len = 0;
+
+    if(sc->mode == SCREEN_APPEND){
+        screen_emit(sc, sc->buf, sc->len);
+    } else if(sc->mode == SCREEN_REDRAW){
+        screen_emit(sc, "\033[H\033[2J", 7); //clears the terminal screen and move the cursor to the top-left corner
+        screen_emit(sc, sc->buf, sc->len);
+    } else {
+        const char *p = sc->buf, *end = sc->buf + sc->len; //lines of the new frame
+        const char *q = sc->prev, *qend = sc->prev + sc->prev_len; //lines of the frame on the terminal
+        int row = 1;
+
+        if(!sc->drawn || atomic_exchange(&term_resized, 0)){ //the first frame, and the first after a resize, start from a clear screen
+            sc->height = screen_height(sc);
+            screen_emit(sc, "\033[H\033[2J", 7);
+            q = qend = NULL;
+        }
+        int last = sc->height ? sc->height : INT_MAX; //last row that can be drawn
+
+        while(p < end && row <= last){
+            const char *nl = memchr(p, '\n', end - p);
+            size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p); //length of the line without the newline
+            size_t line = n + (nl != NULL); //length with the newline
+
+            if(q < qend && (size_t)(qend - q) >= line && memcmp(p, q, line) == 0 && (nl != NULL || q + n == qend)){ //same bytes, newline included: the line is unchanged and the old one need not be scanned
+                q += line;
+            } else { //the line changed, so it is rewritten in place
+                screen_goto(sc, row);
+                screen_emit(sc, p, n);
+                screen_emit(sc, "\033[K", 3); //erases what is left of a longer old line
+                if(q < qend){ //skips the old line at this row
+                    const char *qnl = memchr(q, '\n', qend - q);
+                    q = qnl ? qnl + 1 : qend;
+                }
+            }
+            p += line;
+            row++;
+        }
+        if(q < qend && row <= last){ //the new frame is shorter, so the rest of the old one is erased
+            screen_goto(sc, row);
+            screen_emit(sc, "\033[J", 3);
+        }
+        screen_goto(sc, row <= last ? row : last); //leaves the cursor below the frame, or on the last row if it is clipped
+
+        char *tmp = sc->prev; size_t tmp_cap = sc->prev_cap; //the new frame becomes the previous one, reusing the old buffer
+        sc->prev = sc->buf; sc->prev_len = sc->len; sc->prev_cap = sc->cap;
+        sc->buf = tmp; sc->cap = tmp_cap;
+    }
+
+    for(size_t off = 0; off < sc->out_len; ){ //a single write(2) unless the terminal accepts only part of it
+        ssize_t n = write(sc->fd, sc->out + off, sc->out_len - off);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            break;
+        }
+        off += n;
+    }
+    sc->bytes += sc->out_len;
+    sc->drawn = 1;
+    sc->len = 0;
+}
+
+// frees the buffers of a screen
+void screen_free(struct screen *sc){
+    free(sc->buf);
+    free(sc->prev);
+    free(sc->out);
+    sc->buf = sc->prev = sc->out = NULL;
+    sc->len = sc->cap = sc->prev_len = sc->prev_cap = sc->out_len = sc->out_cap = 0;
+    sc->drawn = 0;
+}
+
 //  displays the number of samples and tdelay between samples
-void display_header(int i, int sequential, int samples, int tdelay){
+void display_header(long long i, int sequential, int samples, double tdelay){
+
+    if(sequential){
+        frame_printf(">>> iteration %lld\n", i); //prints iteration number if sequential
+    } else {
+        //the screen is no longer cleared here; screen_flush redraws only the lines that changed since the last frame
+        if(samples > 0)
+            frame_printf("Nbr of samples: %d -- every %g secs\n", samples, tdelay); //prints the number of samples and tdelay between samples
+        else
+            frame_printf("Nbr of samples: continuous -- every %g secs\n", tdelay); //--samples=0 samples until interrupted
+    }
+
+    struct rusage mem_usage; //declaring a struct of type rusage found in <sys/resource.h>
+    struct rusage *mem_ptr = &mem_usage; //creating pointer pointing to the address of mem_usage
+
+    if(getrusage(RUSAGE_SELF, mem_ptr)==0){ //checks if the call to getrusage is successful
+        frame_printf(" Memory usage: %ld kilobytes\n", mem_ptr->ru_maxrss); //prints memory usage through ru_maxrss field of rusage struct
+    }
+}
+
+//  prints the number of currently available cores using sysconf
+void print_cores(void){
+    int n_cpu = sysconf(_SC_NPROCESSORS_ONLN); //sysconf returns the number of processors (found in <unistd.h>)
+    frame_printf("Number of cores: %d\n", n_cpu); //printing number of cores to stdout
+}
+
+// a file under /proc that is opened once and re-read in place with pread on every sample
+struct proc_file {
+    const char *path; //path of the file, e.g. "/proc/stat"
+    int fd; //file descriptor kept open between samples, -1 until the first read
+    char *buf; //reusable buffer the contents are read into
+    size_t cap; //allocated size of buf in bytes
+    size_t len; //number of bytes read by the latest call to proc_read
+};
+
+struct proc_file proc_stat = {"/proc/stat", -1, NULL, 0, 0}; //persistent reader for /proc/stat
+
+atomic_int stop_requested = 0; //set by the SIGINT/SIGTERM handler to end the sampling loop, atomic because the collector threads read it too
+
+// signal handler that asks the sampling loop to stop so the summary at the end is still printed
+void request_stop(int sig){
+    (void)sig;
+    stop_requested = 1;
+}
+
+// handler of the signal that interrupts the sleep of a collector thread when the pipeline stops; it has nothing to do
+void wake_thread(int sig){
+    (void)sig;
+}
+
+// returns the current wall-clock time in nanoseconds since the epoch
+long long wall_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// returns the current value of the monotonic clock in nanoseconds
+long long now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#define MAX_SECONDS 4.0e9 //longest interval or latest time accepted, in seconds (about 126 years); an epoch time plus such an offset still fits a long long of nanoseconds
+
+/*  parses a sampling interval given as whole or fractional seconds ("2", "0.1", "1.5s") or as milliseconds ("100ms")
+ *   and returns it in nanoseconds, or -1 if the string is not a positive interval
+ */
+long long parse_interval(const char *str){
+    char *end;
+    double secs = strtod(str, &end); //reads the numeric part, which may have a fractional part
+
+    if(end == str || !isfinite(secs) || secs <= 0) return -1; //rejects empty, non-numeric, nan, infinite, zero and negative values
+    if(strcmp(end, "ms") == 0) secs /= 1000; //the "ms" suffix gives the value in milliseconds
+    else if(*end != '\0' && strcmp(end, "s") != 0) return -1; //anything else after the number is an error
+    if(secs > MAX_SECONDS) return -1; //keeps the conversion to nanoseconds within a long long
+
+    long long ns = (long long)(secs * 1e9 + 0.5); //rounds to the nearest nanosecond
+    return ns > 0 ? ns : -1;
+}
+
+// drift-free sampling clock: tick k is due at start + k * interval on CLOCK_MONOTONIC, whatever the work in between took
+struct tick_clock {
+    long long interval_ns; //time between two ticks
+    long long deadline_ns; //absolute time of the next tick
+    long long ticks; //number of ticks waited for
+    long long late; //ticks that woke up a whole interval or more after their deadline
+    long long jitter_min, jitter_max, jitter_sum; //wake-up delay after the deadline, in nanoseconds
+    double jitter_sumsq; //sum of squared delays, for the standard deviation
+};
+
+// starts the clock so that the first tick is due one interval after start_ns (a CLOCK_MONOTONIC time)
+void tick_start(struct tick_clock *tc, long long interval_ns, long long start_ns){
+    memset(tc, 0, sizeof *tc);
+    tc->interval_ns = interval_ns;
+    tc->deadline_ns = start_ns + interval_ns;
+    tc->jitter_min = -1; //no tick has been measured yet
+}
+
+// sleeps until the next deadline with an absolute clock_nanosleep, records how late the wake-up was and advances the deadline
+void tick_wait(struct tick_clock *tc){
+    struct timespec ts;
+    ts.tv_sec = tc->deadline_ns / 1000000000LL;
+    ts.tv_nsec = tc->deadline_ns % 1000000000LL;
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop_requested); //resumes the same absolute sleep unless the signal asked to stop
+    if(stop_requested) return; //an interrupted sleep is not counted as a tick
+
+    long long jitter = now_ns() - tc->deadline_ns; //how long after the deadline the thread actually woke up
+    if(jitter < 0) jitter = 0;
+
+    tc->ticks++;
+    tc->jitter_sum += jitter;
+    tc->jitter_sumsq += (double)jitter * (double)jitter;
+    if(jitter > tc->jitter_max) tc->jitter_max = jitter;
+    if(tc->jitter_min < 0 || jitter < tc->jitter_min) tc->jitter_min = jitter;
+    if(jitter >= tc->interval_ns) tc->late++; //the previous iteration overran the whole interval
+
+    tc->deadline_ns += tc->interval_ns; //the next deadline is computed from the previous one, not from the wake-up time, so errors do not accumulate
+}
+
+// prints the wake-up jitter statistics collected by tick_wait to fp, with the name of the clock and its number of dropped samples
+void print_tick_stats(FILE *fp, const char *name, const struct tick_clock *tc, long long dropped){
+    if(tc->ticks == 0){
+        fprintf(fp, " %s: no ticks\n", name);
+        return;
+    }
+
+    double mean = (double)tc->jitter_sum / tc->ticks;
+    double var = tc->jitter_sumsq / tc->ticks - mean * mean;
+    fprintf(fp, " %s: ticks: %lld, late: %lld, dropped: %lld\n", name, tc->ticks, tc->late, dropped);
+    fprintf(fp, "   jitter (us): min %.1f / mean %.1f / stddev %.1f / max %.1f\n", tc->jitter_min / 1e3, mean / 1e3,
+        sqrt(var > 0 ? var : 0) / 1e3, tc->jitter_max / 1e3);
+}
+
+// the stages timed by --self-stats: one per collector, and the renderer
+enum stage { STAGE_CPU, STAGE_MEMORY, STAGE_UTMP, STAGE_TOP, STAGE_DISK, STAGE_NET, STAGE_RENDER, STAGES };
+const char *const stage_names[STAGES] = {"cpu read", "memory read", "utmp scan", "top scan", "disk read", "net read", "render"};
+
+#define HIST_SUB_BITS 5 //values below 32 ns get a bucket each, larger ones keep their 5 leading bits (16 buckets per power of two, about 6%)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 2) << (HIST_SUB_BITS - 1)) //enough for any 64-bit value
+
+/*  HDR-style latency histogram: log-linear buckets, so the relative error of a percentile is bounded whatever the
+ *   magnitude. Each histogram has a single writer (the thread of its stage); the counters are atomic so the renderer
+ *   can read them for a report while they are being updated.
+ */
+struct latency_hist {
+    atomic_ullong count[HIST_BUCKETS];
+    atomic_ullong n, max; //number of values recorded and the largest one
+};
+
+int self_stats = 0; //set by --self-stats; when 0 no stage is timed, which costs one predictable branch per stage
+struct latency_hist stage_hist[STAGES]; //one histogram per stage, in nanoseconds
+long long self_start_ns; //when the pipeline started, for the share of a core the program used
+atomic_int report_requested = 0; //set by the SIGUSR1 handler (installed with --self-stats only), handled at the renderer's next wake-up
+
+// signal handler that asks for a --self-stats report without stopping
+void request_report(int sig){
+    (void)sig;
+    report_requested = 1;
+}
+
+// returns the current value of CLOCK_MONOTONIC_RAW in nanoseconds, a clock that NTP does not slew
+long long raw_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// returns the bucket of value v: v itself below 32, otherwise its 5 leading bits on top of the position of the highest one
+int hist_bucket(uint64_t v){
+    if(v < (1u << HIST_SUB_BITS)) return (int)v;
+    int top = 63 - __builtin_clzll(v); //position of the highest set bit, at least HIST_SUB_BITS
+    int shift = top - (HIST_SUB_BITS - 1);
+    return ((shift + 1) << (HIST_SUB_BITS - 1)) + (int)(v >> shift) - (1 << (HIST_SUB_BITS - 1));
+}
+
+// returns the largest value that falls into bucket b, the value reported for the percentiles of that bucket
+uint64_t hist_bucket_max(int b){
+    if(b < (1 << HIST_SUB_BITS)) return (uint64_t)b;
+    int half = 1 << (HIST_SUB_BITS - 1);
+    int shift = b / half - 1;
+    uint64_t lead = (uint64_t)(b % half + half);
+    return ((lead + 1) << shift) - 1;
+}
+
+// records one duration in nanoseconds; only the thread of the stage writes, so relaxed atomics are enough
+void hist_record(struct latency_hist *h, long long ns){
+    uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+    atomic_fetch_add_explicit(&h->count[hist_bucket(v)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->n, 1, memory_order_relaxed);
+    if(v > atomic_load_explicit(&h->max, memory_order_relaxed)) atomic_store_explicit(&h->max, v, memory_order_relaxed);
+}
+
+// returns the value below which a fraction q of the recorded values fall (the upper edge of its bucket, at most the maximum)
+uint64_t hist_percentile(const struct latency_hist *h, double q){
+    uint64_t n = atomic_load_explicit(&h->n, memory_order_relaxed);
+    uint64_t rank = (uint64_t)ceil(q * n), seen = 0;
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    if(rank == 0) rank = 1;
+
+    for(int b=0; b<HIST_BUCKETS; b++){
+        seen += atomic_load_explicit(&h->count[b], memory_order_relaxed);
+        if(seen >= rank){
+            uint64_t v = hist_bucket_max(b);
+            return v < max ? v : max;
+        }
+    }
+    return max;
+}
+
+// prints like fprintf to fp, or appends to the frame being assembled if fp is NULL
+void report_printf(FILE *fp, const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    if(fp) vfprintf(fp, fmt, ap);
+    else frame_vprintf(fmt, ap);
+    va_end(ap);
+}
+
+// prints the p50/p99/max of every stage that ran and the user/system cpu time the program has used so far to fp, or into the frame if fp is NULL
+void print_self_stats(FILE *fp){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+    double sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    double wall = (now_ns() - self_start_ns) / 1e9;
+
+    report_printf(fp, "### Self statistics ###\n");
+    report_printf(fp, " %-12s %10s %10s %10s %10s\n", "stage", "count", "p50 (us)", "p99 (us)", "max (us)");
+    for(int k=0; k<STAGES; k++){
+        const struct latency_hist *h = &stage_hist[k];
+        uint64_t n = atomic_load_explicit(&h->n, memory_order_relaxed);
+        if(n == 0) continue; //the stage did not run
+        report_printf(fp, " %-12s %10llu %10.1f %10.1f %10.1f\n", stage_names[k], (unsigned long long)n, hist_percentile(h, 0.50) / 1e3,
+            hist_percentile(h, 0.99) / 1e3, atomic_load_explicit(&h->max, memory_order_relaxed) / 1e3);
+    }
+    report_printf(fp, " own cpu time: user %.3f s, sys %.3f s in %.1f s (%.3f%% of one core)\n", user, sys, wall,
+        wall > 0 ? 100 * (user + sys) / wall : 0.0);
+}
+
+/*  re-reads the whole file described by pf into its buffer and nul-terminates it. The file is opened
+ *   on the first call only; later calls pread from offset 0, which makes the kernel regenerate the contents.
+ *   returns the number of bytes read, or -1 if the file could not be opened or read.
+ */
+ssize_t proc_read(struct proc_file *pf){
+    if(pf->fd < 0){ //opens the file lazily on first use
+        pf->fd = open(pf->path, O_RDONLY | O_CLOEXEC);
+        if(pf->fd < 0) return -1;
+    }
+    if(pf->buf == NULL){ //allocates the initial buffer, which is reused for every later sample
+        pf->cap = 4096;
+        pf->buf = malloc(pf->cap);
+        if(pf->buf == NULL) return -1;
+    }
+
+    for(;;){
+        ssize_t n = pread(pf->fd, pf->buf, pf->cap - 1, 0); //reads the file from the beginning in a single call
+        if(n < 0) return -1;
+
+        if((size_t)n < pf->cap - 1){ //the whole file fit into the buffer
+            pf->buf[n] = '\0';
+            pf->len = (size_t)n;
+            return n;
+        }
+
+        char *bigger = realloc(pf->buf, pf->cap * 2); //the buffer was filled, so it is doubled and the read is retried
+        if(bigger == NULL) return -1;
+        pf->buf = bigger;
+        pf->cap *= 2;
+    }
+}
+
+// closes the descriptor and frees the buffer of a persistent /proc reader
+void proc_close(struct proc_file *pf){
+    if(pf->fd >= 0) close(pf->fd);
+    free(pf->buf);
+    pf->fd = -1;
+    pf->buf = NULL;
+    pf->cap = pf->len = 0;
+}
+
+// parses the unsigned decimal integer at *pp (skipping leading blanks) and advances *pp past it
+unsigned long long scan_ull(const char **pp){
+    const char *p = *pp;
+    unsigned long long v = 0;
+
+    while(*p == ' ' || *p == '\t') p++; //skips the separators between fields
+    while((unsigned)(*p - '0') < 10) v = v * 10 + (unsigned)(*p++ - '0'); //accumulates digits until a non-digit is found
+
+    *pp = p;
+    return v;
+}
+
+/*  takes an array of unsigned long integers as parameter and set its entries to the values of user, 
+ *   nice, system, idle, iowait, irq, softirq fields as found in the file /proc/stat
+ *   /proc/stat stays open between calls and is parsed in place from the buffer filled by proc_read
+ */
+void set_cpu_values(unsigned long cpuArr[7])
+{
+    if(proc_read(&proc_stat) < 0){ //checks if reading /proc/stat is successful
+        fprintf(stderr, "File could not be opened\n"); //if there was an error reading the file, the message is printed to stderr
+        exit(1); //exit program
+    }
+
+    const char *p = proc_stat.buf;
+    if(strncmp(p, "cpu ", 4) != 0){ //the first line must be the aggregate "cpu" line
+        fprintf(stderr, "Error reading file\n"); //prints error message to stderr if error occurs
+        exit(1); //exit program
+    }
+    p += 4; //skips the "cpu " label
+
+    for(int k=0; k<7; k++){
+        cpuArr[k] = scan_ull(&p); //reads user, nice, system, idle, iowait, irq, softirq in order
+    }
+}
+
+// the original fopen/fscanf/fclose implementation of set_cpu_values, kept as the baseline for --bench=sample
+void set_cpu_values_stdio(unsigned long cpuArr[7])
+{
+    FILE *fp = fopen("/proc/stat", "r"); //opening /proc/stat file in read-mode and assigns the returned file pointer to fp
+
+    if(fp==NULL){ //checks if file opening is successful
+        fprintf(stderr, "File could not be opened\n"); //if there was an error opening file, the message is printed to stderr
+        exit(1); //exit program
+    }
+
+    char buffer[255]; //a char array used to store the format string
+    //fscanf is used to read data from the file into the variables
+    int success = fscanf(fp, "%s %lu %lu %lu %lu %lu %lu %lu", buffer, &(cpuArr[0]), &(cpuArr[1]), 
+        &(cpuArr[2]), &(cpuArr[3]), &(cpuArr[4]), &(cpuArr[5]), &(cpuArr[6])); 
+    //specifies that the function should read one string followed by seven unsigned long integers
+
+    if(success!=8){ //checks the number of items successfully read by fscanf
+        fprintf(stderr, "Error reading file\n");    //prints error message to stderr if error occurs
+        fclose(fp); //close file pointer
+        exit(1); //exit program
+    }
+    fclose(fp); //close file pointer
+}
+
+/*
+ *given two unsigned long arrays prev and cur representing the 7 fields of cpu information as obtained from
+ * /proc/stat that were sampled at different times, it calculates and returns the cpu usage percentage.
+ */
+double calculate_cpu_usage(unsigned long prev[7], unsigned long cur[7])
+{
+    //the sums are kept in 64 bits because the aggregate counters exceed the range of int on machines with a long uptime
+    uint64_t idle_prev = (uint64_t)prev[3] + prev[4];  //sum of the idle and iowait fields of /proc/stat in prev sample
+    uint64_t idle_cur = (uint64_t)cur[3] + cur[4]; //sum of idle and and iowait fields of /proc/stat in cur sample
+
+    uint64_t non_idle_prev = (uint64_t)prev[0] + prev[1] + prev[2] + prev[5] + prev[6];    //sum of user, nice, system, irq, and softirq fields of /proc/stat in prev sample
+    uint64_t non_idle_cur = (uint64_t)cur[0] + cur[1] + cur[2] + cur[5] + cur[6];  //sum of user, nice, system, irq, and softirq fields of /proc/stat in cur sample
+
+    uint64_t total_prev = idle_prev + non_idle_prev; //sum of idle_prev and non_idle_prev, giving the total time of the CPU in prev sample
+    uint64_t total_cur = idle_cur + non_idle_cur; //sum of idle_prev and non_idle_prev, giving the total time of the CPU in cur sample
+
+    double total_diff = (double)(total_cur - total_prev); //difference between current and previous total CPU time values
+    double idle_diff = (double)(idle_cur - idle_prev); //difference between current and previous idle time values
+    if(total_diff == 0) return 0.0; //no jiffy elapsed, which happens with sub-second intervals on machines with few cores
+
+    // total_diff - idle_diff gives the difference in CPU utilization between two points in time that excludes idle time,
+    // which gives a measure of how busy the CPU was with non_idle tasks between two sample points in time 
+    // (referred to as utilization of the CPU). Dividing this by the difference of total CPU time yields the fraction of
+    // CPU time spent on non_idle activities, which is then multiplied by 1000 to convert the decimals into a whole number and 1 
+    // is added to avoid division by 0 and to avoid undefined value. Then divided by 10 to get a range between 0-100% as percentage.
+    // Note: formula obtained from TAs in office hours linked in README file
+    return ((1000 * ((total_diff - idle_diff) / total_diff) + 1) / 10);
+
+}
+
+#define CPU_FIELDS 7 //user, nice, system, idle, iowait, irq, softirq
+
+/*  per-cpu counters of /proc/stat stored as a structure of arrays: field[f][r] is field f of row r.
+ *   row 0 is the aggregate "cpu" line and rows 1..n-1 are the "cpuN" lines in file order.
+ */
+struct cpu_table {
+    int n; //number of rows filled by the latest read
+    int cap; //number of rows the columns have room for
+    int *id; //core number of each row, -1 for the aggregate row
+    uint64_t *field[CPU_FIELDS]; //one column of 64-bit counters per /proc/stat field
+};
+
+// (re)allocates the columns of t so that it can hold cap rows, returns 0 on success and -1 on allocation failure
+int cpu_table_reserve(struct cpu_table *t, int cap){
+    if(cap <= t->cap) return 0;
+
+    int *id = realloc(t->id, cap * sizeof *id);
+    if(id == NULL) return -1;
+    t->id = id;
+
+    for(int f=0; f<CPU_FIELDS; f++){
+        uint64_t *col = realloc(t->field[f], cap * sizeof *col); //each column is a separate contiguous array
+        if(col == NULL) return -1;
+        t->field[f] = col;
+    }
+    t->cap = cap;
+    return 0;
+}
+
+// frees the columns of t
+void cpu_table_free(struct cpu_table *t){
+    free(t->id);
+    for(int f=0; f<CPU_FIELDS; f++) free(t->field[f]);
+    memset(t, 0, sizeof *t);
+}
+
+/*  fills t with the aggregate and per-core counters of every "cpu" line of /proc/stat from a single read.
+ *   exits the program if /proc/stat cannot be read, like set_cpu_values.
+ */
+void read_cpu_table(struct cpu_table *t){
+    if(proc_read(&proc_stat) < 0){ //checks if reading /proc/stat is successful
+        fprintf(stderr, "File could not be opened\n");
+        exit(1);
+    }
+
+    const char *p = proc_stat.buf;
+    int r = 0;
+
+    while(strncmp(p, "cpu", 3) == 0){ //the cpu lines are the first lines of the file
+        p += 3;
+        if(r == t->cap && cpu_table_reserve(t, t->cap ? t->cap * 2 : 64) < 0){ //grows the columns when a new core shows up
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+
+        t->id[r] = (*p == ' ') ? -1 : (int)scan_ull(&p); //"cpu " is the aggregate row, "cpuN" is core N
+        for(int f=0; f<CPU_FIELDS; f++) t->field[f][r] = scan_ull(&p);
+        r++;
+
+        p = strchr(p, '\n'); //skips steal, guest and guest_nice
+        if(p == NULL) break;
+        p++;
+    }
+
+    if(r == 0){ //checks that at least the aggregate line was found
+        fprintf(stderr, "Error reading file\n");
+        exit(1);
+    }
+    t->n = r;
+}
+
+// returns 1 if two cpu tables hold the same cores in the same rows, so that their rows can be subtracted one by one
+int cpu_table_same_rows(const struct cpu_table *a, const struct cpu_table *b){
+    return a->n == b->n && memcmp(a->id, b->id, a->n * sizeof *a->id) == 0;
+}
+
+/*  computes the usage percentage of every row of two cpu tables sampled at different times in one pass.
+ *   the loop works on flat columns without branches, which gcc vectorizes at -O3 (16-byte vectors with the
+ *   baseline SSE2, 32-byte ones with AVX2); a row whose total time did not advance gets 0%. prev and cur must
+ *   hold the same rows (checked by the caller with cpu_table_same_rows).
+ */
+void cpu_usage_kernel(const struct cpu_table *prev, const struct cpu_table *cur, double *restrict usage, int n){
+    const uint64_t *restrict pu = prev->field[0], *restrict pn = prev->field[1], *restrict ps = prev->field[2];
+    const uint64_t *restrict pi = prev->field[3], *restrict pw = prev->field[4], *restrict pq = prev->field[5];
+    const uint64_t *restrict pz = prev->field[6];
+    const uint64_t *restrict cu = cur->field[0], *restrict cn = cur->field[1], *restrict cs = cur->field[2];
+    const uint64_t *restrict ci = cur->field[3], *restrict cw = cur->field[4], *restrict cq = cur->field[5];
+    const uint64_t *restrict cz = cur->field[6];
+
+    for(int r=0; r<n; r++){
+        //the deltas of one interval are narrowed to 32 bits before the conversion to double: SSE2 and AVX2 convert packed
+        //32-bit integers, but packed 64-bit conversion needs AVX-512. 2^31 jiffies is over 200 days at 100 Hz.
+        int32_t busy = (int32_t)((cu[r] + cn[r] + cs[r] + cq[r] + cz[r]) - (pu[r] + pn[r] + ps[r] + pq[r] + pz[r])); //non-idle time in the interval
+        int32_t idle = (int32_t)((ci[r] + cw[r]) - (pi[r] + pw[r])); //idle and iowait time in the interval
+        int32_t total = busy + idle;
+        usage[r] = 100.0 * (double)busy / (double)(total + (total == 0)); //adding 1 only when total is 0 avoids a branch and a division by 0
+    }
+}
+
+// copies the counters of row r of t into the 7-field array layout used by calculate_cpu_usage
+void cpu_table_row(const struct cpu_table *t, int r, unsigned long cpuArr[7]){
+    for(int f=0; f<CPU_FIELDS; f++) cpuArr[f] = t->field[f][r];
+}
+
+// prints the usage of every core computed by cpu_usage_kernel, four cores per line
+void print_per_core(const struct cpu_table *t, const double *usage){
+    frame_printf("### Per-core CPU usage ###\n");
+    int col = 0;
+    for(int r=0; r<t->n; r++){
+        if(t->id[r] < 0) continue; //the aggregate row is printed as "total cpu use" already
+        frame_printf(" cpu%-4d %6.2f%%", t->id[r], usage[r]);
+        if(++col % 4 == 0) frame_printf("\n");
+    }
+    if(col % 4 != 0) frame_printf("\n");
+}
+
+// one logged-in session as found in the utmp database
+struct session {
+    char user[UT_NAMESIZE + 1]; //user name, nul-terminated
+    char line[UT_LINESIZE + 1]; //terminal line
+    char host[UT_HOSTSIZE + 1]; //remote host, empty for local sessions
+};
+
+// the sessions found by one scan of the utmp database
+struct session_list {
+    long long tick; //number of the snapshot, set by the sessions collector
+    int n; //number of sessions
+    int cap; //number of sessions s has room for
+    struct session *s; //the sessions
+};
+
+// copies the fixed-size, possibly unterminated utmp field src of size n into dst, which has room for n + 1 bytes
+void copy_utmp_field(char *dst, const char *src, size_t n){
+    size_t len = strnlen(src, n);
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+// appends the session of the utmp record u to the list, growing it as needed
+void session_list_add(struct session_list *list, const struct utmp *u){
+    if(list->n == list->cap){
+        int cap = list->cap ? list->cap * 2 : 16;
+        struct session *bigger = realloc(list->s, cap * sizeof *bigger);
+        if(bigger == NULL){
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        list->s = bigger;
+        list->cap = cap;
+    }
+    struct session *se = &list->s[list->n++];
+    copy_utmp_field(se->user, u->ut_user, sizeof u->ut_user);
+    copy_utmp_field(se->line, u->ut_line, sizeof u->ut_line);
+    copy_utmp_field(se->host, u->ut_host, sizeof u->ut_host);
+}
+
+// fills list with the sessions currently logged onto the system through getutent; kept as the baseline for --bench=users
+void read_sessions(struct session_list *list){
+    list->n = 0;
+    setutent(); //resets the internal stream of the utmp database to the beginning for reading utmp.h file
+    
+    for(struct utmp *user=NULL; (user=getutent());){ //read the records of the utmp database one by one until it returns a NULL pointer signalling the end
+        if(user->ut_type == USER_PROCESS){  //checks if the user is currently logged into the system and running a process
+            session_list_add(list, user);
+        }
+    }
+    endutent(); //closes the internal stream of the utmp database
+}
+
+// prints a list of users/sessions on the system, list may be NULL if no snapshot has arrived yet
+void print_users(const struct session_list *list) {
+
+    frame_printf("### Sessions/users ###\n"); //prints a header
+    
+    for(int k=0; list && k<list->n; k++){
+        const struct session *se = &list->s[k];
+        frame_printf(" %s\t%s\t", se->user, se->line);  //prints username and terminal line
+        
+        if(*(se->host)){  //checks whether the value of host is non-empty
+            frame_printf("(%s)", se->host); //prints host information
+        }
+        frame_printf("\n");
+    }
+}
+
+// replaces the sessions of dst with a copy of the sessions of src
+void session_list_copy(struct session_list *dst, const struct session_list *src){
+    if(dst->cap < src->n){
+        struct session *bigger = realloc(dst->s, src->n * sizeof *bigger);
+        if(bigger == NULL){
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        dst->s = bigger;
+        dst->cap = src->n;
+    }
+    if(src->n) memcpy(dst->s, src->s, src->n * sizeof *dst->s);
+    dst->n = src->n;
+}
+
+/*  fills list with the USER_PROCESS records of the utmp file at path by mapping the file and walking its
+ *   fixed-size struct utmp records directly. returns 0 on success and -1 if the file cannot be opened or mapped.
+ */
+int parse_utmp_file(const char *path, struct session_list *list){
+    list->n = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return -1;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0){
+        close(fd);
+        return -1;
+    }
+    size_t count = st.st_size / sizeof(struct utmp); //a partially written last record is ignored
+    if(count == 0){
+        close(fd);
+        return 0;
+    }
+
+    const struct utmp *rec = mmap(NULL, count * sizeof *rec, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //the mapping stays valid after the descriptor is closed
+    if(rec == MAP_FAILED) return -1;
+
+    for(size_t k=0; k<count; k++){
+        if(rec[k].ut_type == USER_PROCESS) session_list_add(list, &rec[k]); //checks if the user is currently logged into the system and running a process
+    }
+    munmap((void *)rec, count * sizeof *rec);
+    return 0;
+}
+
+// the sessions of a utmp file, re-parsed only when the file changes
+struct session_cache {
+    const char *path; //the utmp file, normally _PATH_UTMP
+    int valid; //whether st and list describe the file
+    struct stat st; //identity, size and modification time of the file at the last parse
+    struct session_list list; //the sessions found by the last parse
+    long long parses; //number of times the file was parsed
+};
+
+/*  stat()s the utmp file and re-parses it only if its inode, size or modification time changed since the last parse.
+ *   returns 1 if the sessions changed, 0 if the cached list is still current.
+ */
+int session_cache_update(struct session_cache *sc){
+    struct stat st;
+    if(stat(sc->path, &st) < 0){ //a missing utmp file means no sessions
+        int changed = sc->valid || sc->parses == 0;
+        sc->valid = 0;
+        sc->list.n = 0;
+        sc->parses += changed;
+        return changed;
+    }
+
+    if(sc->valid && st.st_ino == sc->st.st_ino && st.st_dev == sc->st.st_dev && st.st_size == sc->st.st_size &&
+        st.st_mtim.tv_sec == sc->st.st_mtim.tv_sec && st.st_mtim.tv_nsec == sc->st.st_mtim.tv_nsec){
+        return 0; //login and logout rewrite records, which always updates the modification time
+    }
+
+    sc->valid = parse_utmp_file(sc->path, &sc->list) == 0;
+    sc->st = st;
+    sc->parses++;
+    return 1;
+}
+
+#define PROC_FD_MAX 65536 //most stat descriptors the scanner keeps open, whatever RLIMIT_NOFILE allows
+#define PROC_FD_RESERVE 256 //descriptors below the soft limit left to the rest of the program
+#define PROC_HOT_MAX 512 //processes that used cpu at their latest read and are therefore re-read on the next scan
+#define PROC_ROTATE_READS 1024 //other processes re-read per scan, in turn, so each is read at least every used / 1024 scans
+#define PROC_LIST_CHUNK 2048 //directory entries read per scan while a listing of /proc is in progress
+
+// what the process scanner remembers about one pid between scans
+struct proc_entry {
+    int pid; //0 for an empty slot, -1 for a deleted one
+    int stat_fd; //descriptor of /proc/[pid]/stat kept open between scans, -1 if over the descriptor budget
+    uint64_t ticks; //utime + stime at the latest read, in clock ticks
+    long long read_ns; //monotonic time of the latest read
+    long long seen; //number of the latest directory pass that listed the pid
+    double cpu; //cpu usage over the interval ending at the latest read, in percent of one core
+    char comm[32]; //command name
+};
+
+// one row of the top-N view
+struct top_entry {
+    int pid;
+    char comm[32]; //command name
+    double cpu; //cpu usage in percent of one core
+    uint64_t rss_kb; //resident set size in kilobytes
+};
+
+/*  incremental scanner of /proc/[pid]: keeps a pid-indexed open-addressing hash table of the previous counters,
+ *   the /proc directory open, and one open stat descriptor per process (up to a budget below the RLIMIT_NOFILE soft limit)
+ */
+struct proc_scanner {
+    const char *root; //"/proc", or a synthetic tree for --bench=top
+    DIR *dir; //the root directory, opened once and rewound on every scan
+    struct proc_entry *table; //hash table, cap is a power of two
+    size_t cap, used, deleted; //slots, live entries and deleted entries
+    long long scan; //number of scans done
+    long long now; //monotonic time of the current scan, in nanoseconds
+    double max_cpu; //highest usage a process can have, 100% per online cpu
+    int open_fds, fd_budget; //stat descriptors held open and the most that may be
+    struct top_entry *cand; //scratch array of every live process, partially sorted to select the top N
+    size_t cand_cap;
+    long long nprocs; //processes known after the latest scan
+    int hot[PROC_HOT_MAX], nhot; //pids that used cpu at their latest read, re-read first on the next scan
+    size_t cursor; //table slot the rotating re-read continues from
+    long long pass; //number of the latest directory pass
+    int listing; //whether a directory pass is in progress; it goes on over several scans, PROC_LIST_CHUNK entries at a time
+    char stat_path[256]; //the stat file of the root, whose "processes" line counts the forks since boot
+    struct proc_file stat; //persistent reader of stat_path
+    uint64_t forks; //fork count when the latest directory pass started
+};
+
+// hash slot of pid in a table of cap slots (multiplicative hashing; consecutive pids land in distinct slots)
+size_t pid_slot(int pid, size_t cap){
+    return (size_t)(((uint32_t)pid * 2654435769u) & (cap - 1));
+}
+
+// returns the entry of pid, or the empty slot where it would be inserted (deleted slots are skipped, not reused, until a rehash)
+struct proc_entry *proc_lookup(struct proc_scanner *ps, int pid){
+    size_t k = pid_slot(pid, ps->cap);
+    while(ps->table[k].pid != 0 && ps->table[k].pid != pid) k = (k + 1) & (ps->cap - 1); //linear probing
+    return &ps->table[k];
+}
+
+// rebuilds the hash table with cap slots, dropping the deleted entries
+int proc_rehash(struct proc_scanner *ps, size_t cap){
+    struct proc_entry *old = ps->table;
+    size_t old_cap = ps->cap;
+
+    ps->table = calloc(cap, sizeof *ps->table);
+    if(ps->table == NULL){
+        ps->table = old;
+        return -1;
+    }
+    ps->cap = cap;
+    ps->deleted = 0;
+    for(size_t k=0; k<old_cap; k++){
+        if(old[k].pid > 0) *proc_lookup(ps, old[k].pid) = old[k];
+    }
+    free(old);
+    return 0;
+}
+
+// opens the root directory and sizes the descriptor budget from the current limit, which is left as it is; returns 0 on success and -1 on error
+int proc_scanner_init(struct proc_scanner *ps, const char *root){
+    memset(ps, 0, sizeof *ps);
+    ps->root = root;
+    snprintf(ps->stat_path, sizeof ps->stat_path, "%s/stat", root);
+    ps->stat.path = ps->stat_path;
+    ps->stat.fd = -1;
+    ps->dir = opendir(root);
+    if(ps->dir == NULL || proc_rehash(ps, 1024) < 0) return -1;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    ps->max_cpu = 100.0 * (ncpu > 0 ? ncpu : 1);
+
+    struct rlimit rl; //processes beyond the budget are still read, by opening their stat file for each read
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur > 2 * PROC_FD_RESERVE){
+        rlim_t budget = rl.rlim_cur - PROC_FD_RESERVE; //leaves room for the rest of the program
+        ps->fd_budget = budget > PROC_FD_MAX ? PROC_FD_MAX : (int)budget;
+    }
+    return 0;
+}
+
+// closes every descriptor of the scanner and frees its memory
+void proc_scanner_free(struct proc_scanner *ps){
+    for(size_t k=0; k<ps->cap; k++){
+        if(ps->table[k].pid > 0 && ps->table[k].stat_fd >= 0) close(ps->table[k].stat_fd);
+    }
+    if(ps->dir) closedir(ps->dir);
+    proc_close(&ps->stat);
+    free(ps->table);
+    free(ps->cand);
+    memset(ps, 0, sizeof *ps);
+}
+
+// reads a file relative to the scanner root into buf (of size n), through fd if it is open; returns the length or -1
+ssize_t proc_pid_read(struct proc_scanner *ps, int fd, int pid, const char *name, char *buf, size_t n){
+    ssize_t len;
+    if(fd >= 0){
+        len = pread(fd, buf, n - 1, 0); //the open descriptor is re-read in place
+    } else {
+        char path[64];
+        snprintf(path, sizeof path, "%d/%s", pid, name);
+        fd = openat(dirfd(ps->dir), path, O_RDONLY | O_CLOEXEC); //over the budget: opened for this read only
+        if(fd < 0) return -1;
+        len = pread(fd, buf, n - 1, 0);
+        close(fd);
+    }
+    if(len >= 0) buf[len] = '\0';
+    return len;
+}
+
+// skips one blank-separated field of a /proc line and the blanks before it
+const char *skip_field(const char *p){
+    while(*p == ' ') p++;
+    while(*p && *p != ' ') p++;
+    return p;
+}
+
+/*  parses /proc/[pid]/stat: copies the command name into comm and returns utime + stime in clock ticks.
+ *   the name is taken up to the last ')' because it may itself contain spaces and parentheses. returns 0 if malformed.
+ */
+uint64_t parse_pid_stat(const char *buf, char *comm, size_t n){
+    const char *open = strchr(buf, '('), *close = strrchr(buf, ')');
+    if(open == NULL || close == NULL || close < open) return 0;
+
+    size_t len = (size_t)(close - open - 1) < n - 1 ? (size_t)(close - open - 1) : n - 1;
+    memcpy(comm, open + 1, len);
+    comm[len] = '\0';
+
+    const char *p = skip_field(close + 1); //state
+    for(int f=0; f<10; f++) p = skip_field(p); //ppid, pgrp, session, tty_nr, tpgid, flags, minflt, cminflt, majflt, cmajflt
+    uint64_t utime = scan_ull(&p);
+    uint64_t stime = scan_ull(&p);
+    return utime + stime;
+}
+
+// removes an entry from the hash table and closes its stat descriptor
+void proc_remove(struct proc_scanner *ps, struct proc_entry *e){
+    if(e->stat_fd >= 0){
+        close(e->stat_fd);
+        ps->open_fds--;
+    }
+    e->pid = -1; //deleted marker, so probing continues past the slot
+    ps->used--;
+    ps->deleted++;
+}
+
+/*  re-reads the stat file of one process and updates its cpu usage over the interval since its previous read, and adds
+ *   it to the processes re-read first on the next scan if it used cpu. an entry whose file cannot be read any more is
+ *   removed (the process exited, possibly with its pid already reused).
+ */
+void proc_update(struct proc_scanner *ps, struct proc_entry *e, int fresh){
+    static long clk_tck = 0; //clock ticks per second
+    if(clk_tck == 0) clk_tck = sysconf(_SC_CLK_TCK);
+
+    char buf[1024];
+    if(proc_pid_read(ps, e->stat_fd, e->pid, "stat", buf, sizeof buf) <= 0){
+        proc_remove(ps, e); //if the pid is still listed next time it starts over as a new process
+        return;
+    }
+    uint64_t ticks = parse_pid_stat(buf, e->comm, sizeof e->comm);
+
+    if(!fresh){
+        uint64_t delta = ticks >= e->ticks ? ticks - e->ticks : 0;
+        double secs = (ps->now - e->read_ns) / 1e9;
+        e->cpu = secs > 0 ? 100.0 * delta / clk_tck / secs : 0; //percent of one core over the interval since the previous read
+        if(e->cpu > ps->max_cpu) e->cpu = ps->max_cpu; //the counters advance in whole ticks, so a short interval can overshoot
+        if(e->cpu > 0 && ps->nhot < PROC_HOT_MAX) ps->hot[ps->nhot++] = e->pid;
+    }
+    e->ticks = ticks;
+    e->read_ns = ps->now;
+}
+
+// returns the number of forks since boot from the "processes" line of the stat file of the scanner root, 0 if unavailable
+uint64_t proc_fork_count(struct proc_scanner *ps){
+    if(proc_read(&ps->stat) < 0) return 0;
+    const char *p = strstr(ps->stat.buf, "\nprocesses ");
+    if(p == NULL) return 0;
+    p += 11;
+    return scan_ull(&p);
+}
+
+/*  updates the cpu usage of the processes as of the monotonic time now (in nanoseconds), within a fixed number of
+ *   reads per scan so that the cost does not grow with the number of processes:
+ *   - the processes that used cpu at their latest read (up to PROC_HOT_MAX) are re-read, so the usage of the busy ones,
+ *     and of the top-N, is exact over the latest interval;
+ *   - PROC_ROTATE_READS other processes are re-read in turn. A process that was idle is therefore read at least every
+ *     used / PROC_ROTATE_READS scans: with up to 1024 processes every one is read on every scan, and with 50k a
+ *     process that becomes busy shows up within 49 scans, with its usage averaged since its previous read;
+ *   - the root directory is listed PROC_LIST_CHUNK entries per scan, and a listing only starts when the fork counter
+ *     of the stat file changed, since otherwise no new pid can have appeared; with 50k processes a new one is found
+ *     within 25 scans of its creation, and at the next scan with up to 2048. New pids get an entry and a persistent
+ *     stat descriptor (within the budget); pids not listed by a whole pass are removed, and exited processes are also
+ *     noticed when their stat file can no longer be read.
+ */
+void proc_scan(struct proc_scanner *ps, long long now){
+    ps->scan++;
+    ps->now = now;
+
+    int hot[PROC_HOT_MAX], nhot = ps->nhot; //the busy processes of the previous scan; proc_update collects this scan's
+    memcpy(hot, ps->hot, nhot * sizeof *hot);
+    ps->nhot = 0;
+    for(int h=0; h<nhot; h++){
+        struct proc_entry *e = proc_lookup(ps, hot[h]);
+        if(e->pid == hot[h] && e->read_ns != now) proc_update(ps, e, 0);
+    }
+
+    uint64_t forks = ps->listing ? ps->forks : proc_fork_count(ps);
+    if(!ps->listing && (forks == 0 || forks != ps->forks)){ //a process may have been created: a new directory pass starts
+        ps->forks = forks;
+        ps->pass++;
+        ps->listing = 1;
+        rewinddir(ps->dir); //the directory stays open between scans
+    }
+    for(int listed = 0; ps->listing && listed < PROC_LIST_CHUNK; listed++){
+        struct dirent *de = readdir(ps->dir);
+        if(de == NULL){ //end of the pass: removes the pids it did not list
+            ps->listing = 0;
+            for(size_t k=0; k<ps->cap; k++){
+                if(ps->table[k].pid > 0 && ps->table[k].seen != ps->pass) proc_remove(ps, &ps->table[k]);
+            }
+            break;
+        }
+        if((unsigned)(de->d_name[0] - '0') >= 10) continue; //only the numeric entries are processes
+        const char *name = de->d_name;
+        int pid = (int)scan_ull(&name);
+        if(pid <= 0 || *name != '\0') continue;
+
+        if((ps->used + ps->deleted + 1) * 10 > ps->cap * 7 && proc_rehash(ps, ps->used * 2 > ps->cap / 2 ? ps->cap * 2 : ps->cap) < 0) continue; //keeps the load factor under 0.7
+        struct proc_entry *e = proc_lookup(ps, pid);
+        if(e->pid == 0){ //first time this pid is seen: opens its stat file, within the descriptor budget, and reads it
+            memset(e, 0, sizeof *e);
+            e->pid = pid;
+            e->seen = ps->pass;
+            e->stat_fd = -1;
+            if(ps->open_fds < ps->fd_budget){
+                char path[64];
+                snprintf(path, sizeof path, "%d/stat", pid);
+                e->stat_fd = openat(dirfd(ps->dir), path, O_RDONLY | O_CLOEXEC);
+                if(e->stat_fd >= 0) ps->open_fds++;
+            }
+            ps->used++;
+            proc_update(ps, e, 1);
+        } else {
+            e->seen = ps->pass;
+        }
+    }
+
+    int reads = 0; //the rotating re-read: the next PROC_ROTATE_READS live entries not read yet in this scan
+    for(size_t visited = 0; visited < ps->cap && reads < PROC_ROTATE_READS; visited++){
+        struct proc_entry *e = &ps->table[ps->cursor];
+        ps->cursor = (ps->cursor + 1) & (ps->cap - 1);
+        if(e->pid <= 0 || e->read_ns == now) continue;
+        proc_update(ps, e, 0);
+        reads++;
+    }
+    ps->nprocs = ps->used;
+}
+
+// swaps two rows of the top-N view
+void top_swap(struct top_entry *a, struct top_entry *b){
+    struct top_entry t = *a;
+    *a = *b;
+    *b = t;
+}
+
+// orders rows by decreasing cpu usage, then by increasing pid
+int top_before(const struct top_entry *a, const struct top_entry *b){
+    return a->cpu > b->cpu || (a->cpu == b->cpu && a->pid < b->pid);
+}
+
+// partially orders e[0..n-1] (quickselect) so that its first k rows are the k first in top_before order, in no particular order
+void top_select(struct top_entry *e, size_t n, size_t k){
+    size_t lo = 0, hi = n;
+    while(hi - lo > 1 && k > lo && k < hi){
+        top_swap(&e[lo + (hi - lo) / 2], &e[hi - 1]); //middle element as the pivot
+        size_t store = lo;
+        for(size_t j=lo; j<hi-1; j++){
+            if(top_before(&e[j], &e[hi - 1])) top_swap(&e[j], &e[store++]);
+        }
+        top_swap(&e[store], &e[hi - 1]);
+        if(store == k || store + 1 == k) return;
+        if(store > k) hi = store;
+        else lo = store + 1;
+    }
+}
+
+/*  fills out with the n processes using the most cpu, by quickselect over the busy entries (or every live entry if fewer
+ *   than n are busy) followed by an insertion sort
+ *   of the n winners; the resident set size is read from statm for the winners only. returns the number of rows filled.
+ */
+int proc_top(struct proc_scanner *ps, struct top_entry *out, int n){
+    if(ps->cand_cap < ps->used){
+        struct top_entry *bigger = realloc(ps->cand, ps->used * sizeof *bigger);
+        if(bigger == NULL) return 0;
+        ps->cand = bigger;
+        ps->cand_cap = ps->used;
+    }
+
+    size_t m = 0;
+    if(ps->nhot >= n && ps->nhot < PROC_HOT_MAX){ //the hot list holds every process with a nonzero usage, and enough of them
+        for(int h=0; h<ps->nhot; h++){
+            const struct proc_entry *e = proc_lookup(ps, ps->hot[h]);
+            if(e->pid != ps->hot[h]) continue;
+            ps->cand[m].pid = e->pid;
+            ps->cand[m].cpu = e->cpu;
+            memcpy(ps->cand[m].comm, e->comm, sizeof e->comm);
+            m++;
+        }
+    }
+    if(m < (size_t)n){ //otherwise idle processes are part of the view, and every live entry is a candidate
+        m = 0;
+        for(size_t k=0; k<ps->cap; k++){
+            const struct proc_entry *e = &ps->table[k];
+            if(e->pid <= 0) continue;
+            ps->cand[m].pid = e->pid;
+            ps->cand[m].cpu = e->cpu;
+            memcpy(ps->cand[m].comm, e->comm, sizeof e->comm);
+            m++;
+        }
+    }
+
+    size_t k = (size_t)n < m ? (size_t)n : m;
+    top_select(ps->cand, m, k); //O(m) on average, instead of sorting all m processes
+
+    for(size_t a=1; a<k; a++){ //sorts only the k selected rows
+        for(size_t b=a; b>0 && top_before(&ps->cand[b], &ps->cand[b - 1]); b--) top_swap(&ps->cand[b], &ps->cand[b - 1]);
+    }
+
+    long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    for(size_t a=0; a<k; a++){
+        out[a] = ps->cand[a];
+        char buf[256];
+        const char *p = buf;
+        out[a].rss_kb = 0;
+        if(proc_pid_read(ps, -1, out[a].pid, "statm", buf, sizeof buf) > 0){
+            scan_ull(&p); //size
+            out[a].rss_kb = scan_ull(&p) * page_kb; //resident pages
+        }
+    }
+    return (int)k;
+}
+
+// prints the top-N view
+void print_top(const struct top_entry *e, int n, long long nprocs){
+    frame_printf("### Top %d processes (of %lld) ###\n", n, nprocs);
+    frame_printf(" %7s %6s %10s  %s\n", "PID", "CPU%", "RSS(kB)", "COMMAND");
+    for(int k=0; k<n; k++){
+        frame_printf(" %7d %6.1f %10llu  %s\n", e[k].pid, e[k].cpu, (unsigned long long)e[k].rss_kb, e[k].comm);
+    }
+}
+
+//prints system information about the machine the program is running on
+void print_machine_info(void){
+    struct utsname sysData; //a struct of type utsname is declared (found in <sys/utsname.h>)
+    uname(&sysData); //fills in the fields of the sysData struct with information about the current Operating System
+    printf("### System Information ###\n");
+    printf(" System Name = %s\n", sysData.sysname); //prints system name
+    printf(" Machine Name = %s\n", sysData.nodename); //prints machine name
+    printf(" Version = %s\n", sysData.version); //prints OS version
+    printf(" Release = %s\n", sysData.release); //prints OS/software release
+    printf(" Architecture = %s\n", sysData.machine); //prints machine architecture (computer hardware type)
+}
+
+#define HISTORY_MAX 1024 //maximum number of samples kept in the history; at most HISTORY_MAX - 1 rows are shown
+#define HISTORY_ROWS_DEFAULT 20 //rows shown when sampling continuously and stdout is not a terminal
+#define FRAME_FIXED_ROWS 16 //rows of a frame outside the history windows, kept free when fitting them to the terminal
+
+// one sample kept in the history as raw numbers; the memory and cpu rows are formatted from it only when they are displayed
+struct sample {
+    long long t_ns; //monotonic time the sample was taken at, in nanoseconds
+    long long wall_ns; //wall-clock time of the sample, in nanoseconds since the epoch
+    uint64_t phys_used, phys_total; //used (not reclaimable) and total physical memory in bytes
+    uint64_t phys_avail; //memory available to new programs without swapping (MemAvailable), in bytes
+    uint64_t swap_used, swap_total; //used and total swap space in bytes
+    uint64_t cpu_busy, cpu_total; //non-idle and total cpu time (in jiffies) elapsed since the previous sample
+};
+
+// fixed-capacity ring buffer of samples; sample number seq is stored at slot seq % cap until it is overwritten
+struct sample_ring {
+    struct sample *rec; //the slots
+    int cap; //number of slots
+    long long count; //number of samples pushed so far
+};
+
+// allocates a ring with room for cap samples, returns 0 on success and -1 on allocation failure
+int ring_init(struct sample_ring *ring, int cap){
+    ring->rec = calloc(cap, sizeof *ring->rec);
+    ring->cap = cap;
+    ring->count = 0;
+    return ring->rec ? 0 : -1;
+}
+
+// appends a sample to the ring, overwriting the oldest one once the ring is full
+void ring_push(struct sample_ring *ring, const struct sample *s){
+    ring->rec[ring->count % ring->cap] = *s;
+    ring->count++;
+}
+
+// returns sample number seq, or NULL if it has not been taken yet or has already been overwritten
+const struct sample *ring_get(const struct sample_ring *ring, long long seq){
+    if(seq < 0 || seq >= ring->count || seq < ring->count - ring->cap) return NULL;
+    return &ring->rec[seq % ring->cap];
+}
+
+// frees the slots of the ring
+void ring_free(struct sample_ring *ring){
+    free(ring->rec);
+    ring->rec = NULL;
+    ring->cap = 0;
+    ring->count = 0;
+}
+
+/*  returns the number of rows of the history window: one per sample for a fixed count, otherwise as many
+ *   as fit in the terminal (with graphics, each sample takes a memory row and a cpu row). The ring is given
+ *   one more slot than this, so the oldest row shown still has the previous sample its change is taken from.
+ */
+int history_rows(int samples, int graphics){
+    int rows = samples;
+    if(rows <= 0){ //continuous sampling has no count to size the window with
+        int height = screen_height(&term);
+        rows = height ? (height - FRAME_FIXED_ROWS) / (graphics ? 2 : 1) : HISTORY_ROWS_DEFAULT;
+    }
+    if(rows < 1) rows = 1;
+    if(rows > HISTORY_MAX - 1) rows = HISTORY_MAX - 1;
+    return rows;
+}
+
+// the /proc/meminfo fields kept by the parser, as indices into struct meminfo
+enum meminfo_field {
+    MI_MEM_TOTAL, MI_MEM_FREE, MI_MEM_AVAILABLE, MI_BUFFERS, MI_CACHED, MI_SWAP_CACHED, MI_SWAP_TOTAL, MI_SWAP_FREE,
+    MI_DIRTY, MI_WRITEBACK, MI_SHMEM, MI_SLAB, MI_SRECLAIMABLE, MI_SUNRECLAIM,
+    MI_HUGE_TOTAL, MI_HUGE_FREE, MI_HUGE_SIZE,
+    MI_FIELDS //number of fields
+};
+
+// the key of every field in /proc/meminfo, in the order of enum meminfo_field
+const char *const meminfo_keys[MI_FIELDS] = {
+    "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "SwapCached", "SwapTotal", "SwapFree",
+    "Dirty", "Writeback", "Shmem", "Slab", "SReclaimable", "SUnreclaim",
+    "HugePages_Total", "HugePages_Free", "Hugepagesize"
+};
+
+// one parse of /proc/meminfo: sizes in bytes, except the HugePages_Total and HugePages_Free page counts
+struct meminfo {
+    uint64_t v[MI_FIELDS]; //indexed by enum meminfo_field
+    unsigned found; //bit k is set if field k was present
+};
+
+#define MEMINFO_SLOTS 64 //size of the key lookup table, a power of two
+
+struct proc_file proc_meminfo = {"/proc/meminfo", -1, NULL, 0, 0}; //persistent reader for /proc/meminfo
+unsigned meminfo_seed = 0; //seed of the perfect hash of the keys, 0 until meminfo_init has run
+signed char meminfo_slot[MEMINFO_SLOTS]; //field stored at each hash slot, -1 for the slots no key hashes to
+
+// hashes a key of len bytes into a slot of the lookup table (FNV-1a, started from seed)
+unsigned meminfo_hash(const char *key, size_t len, unsigned seed){
+    unsigned h = seed;
+    for(size_t k=0; k<len; k++) h = (h ^ (unsigned char)key[k]) * 16777619u;
+    return h >> 26; //the top 6 bits, MEMINFO_SLOTS == 64
+}
+
+/*  builds the key lookup table: tries seeds until every key lands in a slot of its own, which makes the hash
+ *   perfect for the known keys. A line of /proc/meminfo then costs one hash and one compare against a single key.
+ */
+void meminfo_init(void){
+    for(unsigned seed=2166136261u; ; seed++){
+        int ok = 1;
+        memset(meminfo_slot, -1, sizeof meminfo_slot);
+        for(int f=0; f<MI_FIELDS && ok; f++){
+            unsigned h = meminfo_hash(meminfo_keys[f], strlen(meminfo_keys[f]), seed);
+            if(meminfo_slot[h] >= 0) ok = 0; //collision, the next seed is tried
+            else meminfo_slot[h] = (signed char)f;
+        }
+        if(ok){
+            meminfo_seed = seed;
+            return;
+        }
+    }
+}
+
+/*  parses the contents of /proc/meminfo (len bytes at buf) into mi without allocating; values followed by "kB"
+ *   are converted to bytes. returns the number of known fields found.
+ */
+int parse_meminfo(const char *buf, size_t len, struct meminfo *mi){
+    const char *p = buf, *end = buf + len;
+    int found = 0;
+
+    if(meminfo_seed == 0) meminfo_init();
+    memset(mi, 0, sizeof *mi);
+    while(p < end){
+        const char *colon = memchr(p, ':', end - p);
+        if(colon == NULL) break;
+        size_t klen = colon - p;
+        int f = meminfo_slot[meminfo_hash(p, klen, meminfo_seed)];
+
+        const char *q = colon + 1;
+        if(f >= 0 && strncmp(meminfo_keys[f], p, klen) == 0 && meminfo_keys[f][klen] == '\0'){ //a single compare settles whether the key is known
+            uint64_t v = scan_ull(&q);
+            if(q[0] == ' ' && q[1] == 'k') v *= 1024; //"kB"
+            mi->v[f] = v;
+            mi->found |= 1u << f;
+            found++;
+        }
+        const char *nl = memchr(q, '\n', end - q);
+        p = nl ? nl + 1 : end;
+    }
+    return found;
+}
+
+// reads /proc/meminfo into mi, returns 0 on success and -1 if the file could not be read
+int read_meminfo(struct meminfo *mi){
+    if(proc_read(&proc_meminfo) < 0) return -1;
+    return parse_meminfo(proc_meminfo.buf, proc_meminfo.len, mi) > 0 ? 0 : -1;
+}
+
+// returns the memory that is reclaimable cache (buffers, page cache and reclaimable slab, minus shared memory), in bytes
+uint64_t meminfo_cache(const struct meminfo *mi){
+    uint64_t cache = mi->v[MI_BUFFERS] + mi->v[MI_CACHED] + mi->v[MI_SRECLAIMABLE];
+    return cache > mi->v[MI_SHMEM] ? cache - mi->v[MI_SHMEM] : 0;
+}
+
+/*  stores the current physical and virtual memory usage in bytes into the sample s, and the fields of /proc/meminfo
+ *   into mi if it is not NULL. "used" is the memory that cannot be reclaimed, MemTotal - MemAvailable, so the page
+ *   cache is not counted as used; kernels without MemAvailable get free + reclaimable cache instead.
+ */
+void write_memory(struct sample *s, struct meminfo *mi){
+    struct meminfo local;
+    if(mi == NULL) mi = &local;
+
+    if(read_meminfo(mi) < 0){ //falls back to sysinfo(2) if /proc/meminfo is not readable
+        struct sysinfo sys_info;    //a struct of type sysinfo is declared to store system information (from <sys/sysinfo.h>)
+        sysinfo(&sys_info); //retrieves information about the system into sys_info
+        uint64_t unit = sys_info.mem_unit; //sizes in sys_info are given in multiples of mem_unit bytes
+
+        memset(mi, 0, sizeof *mi);
+        mi->v[MI_MEM_TOTAL] = (uint64_t)sys_info.totalram * unit;
+        mi->v[MI_MEM_FREE] = (uint64_t)sys_info.freeram * unit;
+        mi->v[MI_BUFFERS] = (uint64_t)sys_info.bufferram * unit;
+        mi->v[MI_SHMEM] = (uint64_t)sys_info.sharedram * unit;
+        mi->v[MI_SWAP_TOTAL] = (uint64_t)sys_info.totalswap * unit;
+        mi->v[MI_SWAP_FREE] = (uint64_t)sys_info.freeswap * unit;
+    }
+    if(!(mi->found & (1u << MI_MEM_AVAILABLE))) mi->v[MI_MEM_AVAILABLE] = mi->v[MI_MEM_FREE] + meminfo_cache(mi); //estimate for kernels before 3.14
+    if(mi->v[MI_MEM_AVAILABLE] > mi->v[MI_MEM_TOTAL]) mi->v[MI_MEM_AVAILABLE] = mi->v[MI_MEM_TOTAL];
+
+    s->phys_total = mi->v[MI_MEM_TOTAL];
+    s->phys_avail = mi->v[MI_MEM_AVAILABLE];
+    s->phys_used = s->phys_total - s->phys_avail; //memory in use that the kernel could not hand out without swapping
+    s->swap_total = mi->v[MI_SWAP_TOTAL];
+    s->swap_used = mi->v[MI_SWAP_TOTAL] >= mi->v[MI_SWAP_FREE] ? mi->v[MI_SWAP_TOTAL] - mi->v[MI_SWAP_FREE] : 0; //swap used is the total minus the free swap space
+}
+
+// returns the virtual memory used by the system in gigabytes (used physical memory plus used swap)
+double sample_virt_used(const struct sample *s){
+    return (double)(s->phys_used + s->swap_used) / 1024 / 1024 / 1024;
+}
+
+// returns the cpu usage percentage of a sample, using the same formula as calculate_cpu_usage
+double sample_cpu_usage(const struct sample *s){
+    double total_diff = (double)s->cpu_total; //total cpu time elapsed since the previous sample
+    double idle_diff = (double)(s->cpu_total - s->cpu_busy); //idle cpu time elapsed since the previous sample
+    if(total_diff == 0) return 0.0; //no jiffy elapsed, which happens with sub-second intervals on machines with few cores
+    return ((1000 * ((total_diff - idle_diff) / total_diff) + 1) / 10);
+}
+
+#define BAR_MAX 1024 //longest bar, in characters
+#define BAR_ROW_SIZE (3 * BAR_MAX + 256) //a row: the text, then up to BAR_MAX characters of bar (3 bytes each as sparkline blocks), then the values
+
+// how the graphics bars are drawn, set with --bar-width, --bar-scale and --sparkline
+struct bar_style {
+    int width; //characters of a full-scale bar (100% cpu, 1 GB of memory change); 0 keeps the original relative bars
+    double scale; //factor the values of scaled bars and sparklines are multiplied by before they become lengths
+    int spark; //draws each chart as one sparkline of the history instead of one bar per sample
+};
+
+struct bar_style bars = {0, 1.0, 0}; //the original bars by default
+char bar_row[BAR_ROW_SIZE]; //preallocated buffer every graphics row is built in (only the renderer thread draws)
+
+// the eight Unicode blocks of a sparkline, lowest to highest, in UTF-8
+const char spark_blocks[8][4] = {"\xe2\x96\x81", "\xe2\x96\x82", "\xe2\x96\x83", "\xe2\x96\x84", "\xe2\x96\x85", "\xe2\x96\x86", "\xe2\x96\x87", "\xe2\x96\x88"};
+
+// returns the length of the bar of value on a scale where full fills width characters, clamped to [0, width]
+int bar_length(double value, double full, int width){
+    double len = value / full * width + 0.5; //rounded, computed from the value itself rather than accumulated
+    if(len <= 0) return 0;
+    return len >= width ? width : (int)len;
+}
+
+// fills n characters of a row with c and returns the position after them
+char *put_bar(char *p, int c, int n){
+    memset(p, c, n);
+    return p + n;
+}
+
+// appends the sparkline block of value on a scale of 0 to full and returns the position after it
+char *put_spark(char *p, double value, double full){
+    int k = (int)(value / full * 8);
+    if(k > 7) k = 7;
+    if(k < 0) k = 0;
+    memcpy(p, spark_blocks[k], 3);
+    return p + 3;
+}
+
+// returns the number of samples a sparkline ending at sample i shows: the bar width (60 by default), or fewer if the history is shorter
+int spark_length(const struct sample_ring *ring, long long i){
+    long long n = bars.width ? bars.width : 60;
+    if(n > i + 1) n = i + 1;
+    if(n > ring->cap) n = ring->cap;
+    return (int)n;
+}
+
+// formats the physical and virtual memory usage of a sample into line, which has room for n bytes
+void format_memory(char *line, size_t n, const struct sample *s){
+    double gb = 1024.0 * 1024 * 1024; //bytes in a gigabyte
+    snprintf(line, n, "%.2f GB / %.2f GB -- %.2f GB / %.2f GB -- %.2f GB",
+        s->phys_used / gb, s->phys_total / gb, sample_virt_used(s), (s->phys_total + s->swap_total) / gb, s->phys_avail / gb);
+}
+
+/*  prints where the physical memory of the latest /proc/meminfo reading went. With graphics, a bar of width
+ *   characters splits the memory into used ('#'), reclaimable cache ('~') and free ('.') memory.
+ */
+void print_meminfo(const struct meminfo *mi, int graphics, int width){
+    double gb = 1024.0 * 1024 * 1024; //bytes in a gigabyte
+    uint64_t total = mi->v[MI_MEM_TOTAL];
+    uint64_t used = total - mi->v[MI_MEM_AVAILABLE];
+    uint64_t cache = meminfo_cache(mi);
+
+    frame_printf(" buffers %.2f GB, cached %.2f GB, slab %.2f GB (%.2f GB reclaimable), dirty %.1f MB, shmem %.2f GB\n",
+        mi->v[MI_BUFFERS] / gb, mi->v[MI_CACHED] / gb, mi->v[MI_SLAB] / gb, mi->v[MI_SRECLAIMABLE] / gb,
+        mi->v[MI_DIRTY] / 1048576.0, mi->v[MI_SHMEM] / gb);
+    if(mi->v[MI_HUGE_TOTAL])
+        frame_printf(" huge pages: %llu / %llu free (%llu kB each)\n", (unsigned long long)mi->v[MI_HUGE_FREE],
+            (unsigned long long)mi->v[MI_HUGE_TOTAL], (unsigned long long)(mi->v[MI_HUGE_SIZE] / 1024));
+
+    if(graphics && total){
+        if(width > BAR_MAX) width = BAR_MAX;
+        int n_used = bar_length((double)used, (double)total, width);
+        int n_cache = bar_length((double)cache, (double)total, width);
+        if(n_cache > width - n_used) n_cache = width - n_used;
+        char *p = put_bar(bar_row, ' ', 1);
+        *p++ = '[';
+        p = put_bar(p, '#', n_used);
+        p = put_bar(p, '~', n_cache);
+        p = put_bar(p, '.', width - n_used - n_cache);
+        p += snprintf(p, 128, "] used %.2f GB, cache %.2f GB, available %.2f GB\n", used / gb, cache / gb, mi->v[MI_MEM_AVAILABLE] / gb);
+        frame_write(bar_row, p - bar_row);
+    }
+}
+
+// appends the graphical representation of the change in virtual memory usage since the previous sample to line
+void modify_memory_graphics(char *line, size_t n, const struct sample *s, const struct sample *prev){
+    double virt_used = sample_virt_used(s);
+    double diff = prev ? virt_used - sample_virt_used(prev) : 0.00; //on the first sample there is no previous one, so no change
+    size_t len = strlen(line);
+
+    len += snprintf(line + len, n - len, "   |");
+
+    if(diff>=0.00 && diff<0.01){
+        len += snprintf(line + len, n - len, "o "); //if the differenece is nonnegative and less than 0.01 GB, then "o" is appended to 'line'
+    } else if (diff<0 && diff>-0.01){
+        len += snprintf(line + len, n - len, "@ "); //if the difference is negative and greater than -0.01 GB, then "@" is appended to 'line'
+    } else {
+        int room = n - len > 64 ? (int)(n - len - 64) : 0; //keeps room for the values after the bar
+        int iter = bars.width ? bar_length(fabs(diff) * bars.scale, 1.0, bars.width) //scaled: a full bar is a change of 1 GB
+            : bar_length(fabs(diff), 0.01 * BAR_MAX, BAR_MAX); //original: one character per 0.01 GB of change, at most BAR_MAX
+        if(iter > room) iter = room;
+        len = put_bar(line + len, diff<0 ? ':' : '#', iter) - line; //':' for a decrease and '#' for an increase, written in one memset
+        len += snprintf(line + len, n - len, diff<0 ? "@ " : "* "); //then appends "@ " or "* " to the string
+    }
+
+    snprintf(line + len, n - len, "%.2f (%.2f)", diff, virt_used); //appends the difference of virtual memory (prev and cur) and virtual used memory
+}
+
+// displays the virtual memory used by the samples ending at sample i as one sparkline, on a scale of 0 to the total virtual memory
+void memory_sparkline(const struct sample_ring *ring, long long i){
+    int n = spark_length(ring, i);
+    char *p = put_bar(bar_row, ' ', 9);
+    for(long long j=i - n + 1; j<=i; j++){
+        const struct sample *s = ring_get(ring, j);
+        p = put_spark(p, (double)(s->phys_used + s->swap_used) * bars.scale, (double)(s->phys_total + s->swap_total));
+    }
+    p += snprintf(p, 64, " %.2f GB\n", sample_virt_used(ring_get(ring, i)));
+    frame_write(bar_row, p - bar_row);
+}
+
+//displays the memory usage of the samples in the history window ending at sample i according to sequential flag
+void display_memory_line(int sequential, int rows, long long i, const struct sample_ring *ring, int graphics){
+    long long first = i - rows + 1 < 0 ? 0 : i - rows + 1; //oldest sample of the window
+    frame_printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot -- Available)\n"); //prints header
+
+    for(long long j=first; j<first+rows; j++){
+        const struct sample *s = ring_get(ring, j);
+        if(s == NULL || (sequential && j != i)){ //rows past the current sample, and rows other than the current one in sequential mode, stay blank
+            frame_printf("\n");
+            continue;
+        }
+        format_memory(bar_row, sizeof bar_row, s); //only the rows that are actually shown are formatted, in the preallocated row
+        const struct sample *prev = ring_get(ring, j - 1); //NULL for the first sample, or if it has already left the ring
+        if(graphics && !bars.spark && (prev != NULL || j == 0)) //a row whose previous sample is gone shows no change rather than a wrong one
+            modify_memory_graphics(bar_row, sizeof bar_row, s, prev);
+        size_t len = strlen(bar_row);
+        bar_row[len++] = '\n';
+        frame_write(bar_row, len);
+    }
+    if(graphics && bars.spark) memory_sparkline(ring, i);
+}
+
+//  displays the CPU usage graphics of the samples in the history window ending at sample i
+//  the number of bars of a row is 3 plus the change in the integer part of the usage since the first sample,
+//  or the usage scaled to the bar width; with --sparkline the whole window is one line
+void cpu_graphics(const struct sample_ring *ring, long long i, int sequential, int rows, int base_usage){
+    long long first = i - rows + 1 < 0 ? 0 : i - rows + 1; //oldest sample of the window
+
+    if(bars.spark){
+        int n = spark_length(ring, i);
+        char *p = put_bar(bar_row, ' ', 9);
+        for(long long j=i - n + 1; j<=i; j++) p = put_spark(p, sample_cpu_usage(ring_get(ring, j)) * bars.scale, 100.0);
+        p += snprintf(p, 64, " %.2f\n", sample_cpu_usage(ring_get(ring, i)));
+        frame_write(bar_row, p - bar_row);
+        return;
+    }
+
+    for(long long j=first; j<=i; j++){
+        const struct sample *s = ring_get(ring, j);
+        if(sequential && j != i){ //in sequential mode only the current row is printed, the earlier ones are left blank
+            frame_printf("\n");
+            continue;
+        }
+        double usage = sample_cpu_usage(s);
+        int num_bar = bars.width ? bar_length(usage * bars.scale, 100.0, bars.width) //scaled: a full bar is 100%
+            : 3 + (int)usage - base_usage; //original: computed from the usage itself, so it cannot drift
+        if(num_bar < 0) num_bar = 0;
+        if(num_bar > BAR_MAX) num_bar = BAR_MAX;
+
+        char *p = put_bar(bar_row, ' ', 9); //indent, then the bar, each written in one memset
+        p = put_bar(p, '|', num_bar);
+        p += snprintf(p, 64, "%.2f\n", usage);
+        frame_write(bar_row, p - bar_row);
+    }
+}
+
+// output formats selected with --format
+enum output_format {
+    FORMAT_TEXT, //the human-readable screen
+    FORMAT_CSV, //one comma-separated line per sample, after a header line
+    FORMAT_JSONL, //one JSON object per line per sample
+    FORMAT_BIN //fixed-layout little-endian records after a file header
+};
+
+#define BIN_MAGIC "MSSBIN1" //first 8 bytes (with the nul) of a binary capture
+#define BIN_HEADER_SIZE 16 //magic, u16 version, u16 record size, u32 reserved
+#define BIN_RECORD_SIZE 80 //ten little-endian 64-bit fields, see encode_bin
+#define BIN_RECORD_SIZE_V1 72 //records of version 1 captures, which have no phys_avail field
+#define STREAM_BUF_SIZE 65536 //bytes buffered before a write(2)
+#define STREAM_FLUSH_NS 100000000LL //buffered records are written out at least every 100 ms
+
+// a buffered output stream that records are encoded into directly, flushed with write(2)
+struct out_stream {
+    int fd; //file descriptor the records are written to
+    size_t len; //number of bytes in buf
+    long long last_flush; //monotonic time of the latest flush
+    int error; //errno of the first failed write, after which every record is dropped; 0 while writes succeed
+    char buf[STREAM_BUF_SIZE]; //encoded records not written yet
+};
+
+/*  writes the buffered bytes of the stream to its file descriptor, continuing after partial writes. The buffer is
+ *   always emptied: on a write error the bytes not written yet are dropped, so none is ever written twice, and the
+ *   error is latched in os->error. returns 0 on success and -1 if a write failed, now or before.
+ */
+int stream_flush(struct out_stream *os){
+    for(size_t off = 0; off < os->len && !os->error; ){
+        ssize_t n = write(os->fd, os->buf + off, os->len - off);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            os->error = n < 0 ? errno : EIO; //a write of 0 bytes would never make progress
+            break;
+        }
+        off += n;
+    }
+    os->len = 0;
+    os->last_flush = now_ns();
+    return os->error ? -1 : 0;
+}
+
+// writes the buffered records out if the latest write is older than STREAM_FLUSH_NS, so a slow sampling rate does not hold them back
+void stream_tick(struct out_stream *os, long long now){
+    if(os->len && now - os->last_flush >= STREAM_FLUSH_NS) stream_flush(os);
+}
+
+// returns a pointer to room for n more bytes (at most STREAM_BUF_SIZE) in the stream buffer, flushing it first if it is too full;
+// the flush always empties the buffer, so the room is there even after a write error
+char *stream_reserve(struct out_stream *os, size_t n){
+    if(os->len + n > sizeof os->buf) stream_flush(os);
+    return os->buf + os->len;
+}
+
+// writes v in decimal at p and returns the position after the last digit
+char *put_u64(char *p, uint64_t v){
+    char tmp[20];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while(v); //digits come out least significant first
+    while(n) *p++ = tmp[--n];
+    return p;
+}
+
+// writes a non-negative fixed-point value given in hundredths, e.g. 1234 as "12.34", and returns the position after it
+char *put_hundredths(char *p, uint64_t v){
+    p = put_u64(p, v / 100);
+    *p++ = '.';
+    *p++ = (char)('0' + v / 10 % 10);
+    *p++ = (char)('0' + v % 10);
+    return p;
+}
+
+// copies the nul-terminated string str to p and returns the position after it
+char *put_str(char *p, const char *str){
+    while(*str) *p++ = *str++;
+    return p;
+}
+
+// stores v at p as 8 little-endian bytes, whatever the byte order of the machine
+void put_le64(unsigned char *p, uint64_t v){
+    for(int k=0; k<8; k++) p[k] = (unsigned char)(v >> (8 * k));
+}
+
+// reads 8 little-endian bytes at p
+uint64_t get_le64(const unsigned char *p){
+    uint64_t v = 0;
+    for(int k=7; k>=0; k--) v = (v << 8) | p[k];
+    return v;
+}
+
+// returns the exact busy/total ratio of a sample in hundredths of a percent, rounded, for the csv and jsonl encoders;
+// the +1 of sample_cpu_usage is only for the text view, so an idle sample exports 0.00 rather than 0.10
+uint64_t sample_usage_hundredths(const struct sample *s){
+    if(s->cpu_total == 0) return 0; //no jiffy elapsed
+    unsigned __int128 busy = s->cpu_busy; //128 bits, so busy * 10000 cannot overflow
+    return (uint64_t)((busy * 10000 + s->cpu_total / 2) / s->cpu_total);
+}
+
+// writes what comes before the first record: the csv column names or the binary file header
+void encode_header(struct out_stream *os, enum output_format fmt){
+    if(fmt == FORMAT_CSV){
+        char *p = stream_reserve(os, 128);
+        p = put_str(p, "seq,t_ns,wall_ns,phys_used,phys_total,phys_avail,swap_used,swap_total,cpu_busy,cpu_total,cpu_usage\n");
+        os->len = p - os->buf;
+    } else if(fmt == FORMAT_BIN){
+        unsigned char *p = (unsigned char *)stream_reserve(os, BIN_HEADER_SIZE);
+        memset(p, 0, BIN_HEADER_SIZE);
+        memcpy(p, BIN_MAGIC, 8);
+        p[8] = 2; //format version, little-endian u16
+        p[10] = BIN_RECORD_SIZE; //record size, little-endian u16
+        os->len += BIN_HEADER_SIZE;
+    }
+}
+
+/*  binary record layout, all fields little-endian 64-bit:
+ *   seq, t_ns, wall_ns, phys_used, phys_total, swap_used, swap_total, cpu_busy, cpu_total, phys_avail
+ *   (version 1 records stop before phys_avail)
+ */
+void encode_bin(unsigned char *p, long long seq, const struct sample *s){
+    put_le64(p, (uint64_t)seq);
+    put_le64(p + 8, (uint64_t)s->t_ns);
+    put_le64(p + 16, (uint64_t)s->wall_ns);
+    put_le64(p + 24, s->phys_used);
+    put_le64(p + 32, s->phys_total);
+    put_le64(p + 40, s->swap_used);
+    put_le64(p + 48, s->swap_total);
+    put_le64(p + 56, s->cpu_busy);
+    put_le64(p + 64, s->cpu_total);
+    put_le64(p + 72, s->phys_avail);
+}
+
+// reads a binary record of size bytes written by encode_bin back into seq and s
+void decode_bin(const unsigned char *p, size_t size, long long *seq, struct sample *s){
+    *seq = (long long)get_le64(p);
+    s->t_ns = (long long)get_le64(p + 8);
+    s->wall_ns = (long long)get_le64(p + 16);
+    s->phys_used = get_le64(p + 24);
+    s->phys_total = get_le64(p + 32);
+    s->swap_used = get_le64(p + 40);
+    s->swap_total = get_le64(p + 48);
+    s->cpu_busy = get_le64(p + 56);
+    s->cpu_total = get_le64(p + 64);
+    s->phys_avail = size >= BIN_RECORD_SIZE ? get_le64(p + 72) : 0; //unknown in version 1 captures
+}
+
+// encodes sample number seq as one record straight into the stream buffer, without building intermediate strings
+void encode_sample(struct out_stream *os, enum output_format fmt, long long seq, const struct sample *s){
+    if(fmt == FORMAT_BIN){
+        encode_bin((unsigned char *)stream_reserve(os, BIN_RECORD_SIZE), seq, s);
+        os->len += BIN_RECORD_SIZE;
+    } else if(fmt == FORMAT_CSV){
+        char *start = stream_reserve(os, 256), *p = start; //a record is at most 11 numbers of 20 digits plus separators
+        p = put_u64(p, seq); *p++ = ',';
+        p = put_u64(p, s->t_ns); *p++ = ',';
+        p = put_u64(p, s->wall_ns); *p++ = ',';
+        p = put_u64(p, s->phys_used); *p++ = ',';
+        p = put_u64(p, s->phys_total); *p++ = ',';
+        p = put_u64(p, s->phys_avail); *p++ = ',';
+        p = put_u64(p, s->swap_used); *p++ = ',';
+        p = put_u64(p, s->swap_total); *p++ = ',';
+        p = put_u64(p, s->cpu_busy); *p++ = ',';
+        p = put_u64(p, s->cpu_total); *p++ = ',';
+        p = put_hundredths(p, sample_usage_hundredths(s)); *p++ = '\n';
+        os->len += p - start;
+    } else if(fmt == FORMAT_JSONL){
+        char *start = stream_reserve(os, 384), *p = start;
+        p = put_str(p, "{\"seq\":"); p = put_u64(p, seq);
+        p = put_str(p, ",\"t_ns\":"); p = put_u64(p, s->t_ns);
+        p = put_str(p, ",\"wall_ns\":"); p = put_u64(p, s->wall_ns);
+        p = put_str(p, ",\"phys_used\":"); p = put_u64(p, s->phys_used);
+        p = put_str(p, ",\"phys_total\":"); p = put_u64(p, s->phys_total);
+        p = put_str(p, ",\"phys_avail\":"); p = put_u64(p, s->phys_avail);
+        p = put_str(p, ",\"swap_used\":"); p = put_u64(p, s->swap_used);
+        p = put_str(p, ",\"swap_total\":"); p = put_u64(p, s->swap_total);
+        p = put_str(p, ",\"cpu_busy\":"); p = put_u64(p, s->cpu_busy);
+        p = put_str(p, ",\"cpu_total\":"); p = put_u64(p, s->cpu_total);
+        p = put_str(p, ",\"cpu_usage\":"); p = put_hundredths(p, sample_usage_hundredths(s));
+        p = put_str(p, "}\n");
+        os->len += p - start;
+    }
+}
+
+// parses the argument of --format, returns -1 if it is not one of text, csv, jsonl or bin
+int parse_format(const char *str){
+    if(strcmp(str, "text") == 0) return FORMAT_TEXT;
+    if(strcmp(str, "csv") == 0) return FORMAT_CSV;
+    if(strcmp(str, "jsonl") == 0) return FORMAT_JSONL;
+    if(strcmp(str, "bin") == 0) return FORMAT_BIN;
+    return -1;
+}
+
+/*  reads a binary capture written with --format=bin and re-encodes every record to stdout in the given format
+ *   (csv if fmt is text or bin). returns the exit status of the program.
+ */
+int decode_capture(const char *path, enum output_format fmt){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        fprintf(stderr, "File could not be opened\n");
+        return 1;
+    }
+
+    unsigned char header[BIN_HEADER_SIZE];
+    if(read(fd, header, sizeof header) != (ssize_t)sizeof header || memcmp(header, BIN_MAGIC, 8) != 0 ||
+        (header[10] != BIN_RECORD_SIZE && header[10] != BIN_RECORD_SIZE_V1)){ //checks the magic and the record size
+        fprintf(stderr, "Not a binary capture: %s\n", path);
+        close(fd);
+        return 1;
+    }
+
+    if(fmt != FORMAT_JSONL) fmt = FORMAT_CSV;
+    static struct out_stream os; //static because of the size of the buffer
+    os.fd = STDOUT_FILENO;
+    os.len = 0;
+    encode_header(&os, fmt);
+
+    size_t size = header[10]; //record size of the capture's version
+    unsigned char block[BIN_RECORD_SIZE * 512]; //records are read 512 at a time
+    size_t have = 0;
+    for(;;){
+        ssize_t n = read(fd, block + have, sizeof block - have);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+        have += n;
+
+        size_t used = 0;
+        for(; used + size <= have; used += size){
+            long long seq;
+            struct sample s;
+            decode_bin(block + used, size, &seq, &s);
+            encode_sample(&os, fmt, seq, &s);
+        }
+        memmove(block, block + used, have - used); //keeps a partial record for the next read
+        have -= used;
+        if(os.error) break; //the output cannot be written, so there is no point in decoding the rest
+    }
+    if(have && !os.error) fprintf(stderr, "Ignoring %zu trailing bytes of a truncated record\n", have);
+
+    stream_flush(&os);
+    close(fd);
+    if(os.error){
+        fprintf(stderr, "Could not write the records: %s\n", strerror(os.error));
+        return 1;
+    }
+    return 0;
+}
+
+/*  columnar capture file written by --record and read by --replay, all integers little-endian:
+ *   - a CAP_HEADER_SIZE header: magic "MSSCOL1\0", u16 version, u16 number of columns, u32 rows per block,
+ *     u64 block size, u64 sampling interval, u64 number of cores, u64 creation time, then the uname strings
+ *   - fixed-size blocks of CAP_BLOCK_ROWS rows, each a CAP_BLOCK_HEADER header (u64 row count, u64 number of the
+ *     first row, u64 wall-clock time of the first and of the last row) followed by one array of CAP_BLOCK_ROWS
+ *     u64 values per column. The block headers form a sparse time index, so a reader binary-searches the blocks
+ *     by timestamp and then reads only the columns and rows it needs, straight from the mapping.
+ */
+#define CAP_MAGIC "MSSCOL1" //8 bytes with the terminating nul
+#define CAP_HEADER_SIZE 4096 //one page, so that the blocks are page-aligned
+#define CAP_BLOCK_HEADER 64 //row count, first row number, first and last seek time, padding
+#define CAP_BLOCK_ROWS 4096 //rows per block: a block spans a little over an hour at 1 Hz
+#define CAP_UNAME_LEN 65 //room for each uname string, as in struct utsname on Linux
+
+#define CAP_VERSION 2 //version 2 added the seek column
+
+/*  the columns of a capture, one per field of struct sample, then the seek time: the wall-clock time of the first
+ *   sample of a recording session plus the monotonic time elapsed since it, and never less than the seek time of
+ *   the rows before it. Unlike the wall-clock column, it only grows, so the window of a replay is found by binary search
+ *   even after a clock step or when a session was appended to a capture with later timestamps.
+ */
+enum capture_col { COL_T_NS, COL_WALL_NS, COL_PHYS_USED, COL_PHYS_TOTAL, COL_PHYS_AVAIL, COL_SWAP_USED, COL_SWAP_TOTAL, COL_CPU_BUSY, COL_CPU_TOTAL, COL_SEEK_NS, CAP_COLS };
+
+// returns the size of a block: its header and the columns, rounded up to whole pages so every block can be mapped alone
+size_t cap_block_size(void){
+    size_t size = CAP_BLOCK_HEADER + (size_t)CAP_COLS * CAP_BLOCK_ROWS * 8;
+    return (size + 4095) & ~(size_t)4095;
+}
+
+// returns the address of the value of column col in row row of the block at b
+unsigned char *cap_cell(unsigned char *b, int col, long long row){
+    return b + CAP_BLOCK_HEADER + ((size_t)col * CAP_BLOCK_ROWS + row) * 8;
+}
+
+/*  returns the row count of the block at b. It is read with acquire ordering, which pairs with the release store of
+ *   cap_set_rows, so the rows it counts are completely written even while the capture is being recorded. A count
+ *   above CAP_BLOCK_ROWS (a damaged file) is clamped, so no row outside the block is ever read.
+ */
+uint64_t cap_rows(const unsigned char *b){
+    uint64_t n = le64toh(atomic_load_explicit((_Atomic uint64_t *)b, memory_order_acquire)); //the count is little-endian in the file
+    return n > CAP_BLOCK_ROWS ? CAP_BLOCK_ROWS : n;
+}
+
+// publishes the row count of the block at b with a single release store, so a reader never sees a torn count
+void cap_set_rows(unsigned char *b, uint64_t n){
+    atomic_store_explicit((_Atomic uint64_t *)b, htole64(n), memory_order_release);
+}
+
+// stores the fields of s into row row of the block at b (the seek time is stored by capture_append)
+void cap_put_row(unsigned char *b, long long row, const struct sample *s){
+    put_le64(cap_cell(b, COL_T_NS, row), (uint64_t)s->t_ns);
+    put_le64(cap_cell(b, COL_WALL_NS, row), (uint64_t)s->wall_ns);
+    put_le64(cap_cell(b, COL_PHYS_USED, row), s->phys_used);
+    put_le64(cap_cell(b, COL_PHYS_TOTAL, row), s->phys_total);
+    put_le64(cap_cell(b, COL_PHYS_AVAIL, row), s->phys_avail);
+    put_le64(cap_cell(b, COL_SWAP_USED, row), s->swap_used);
+    put_le64(cap_cell(b, COL_SWAP_TOTAL, row), s->swap_total);
+    put_le64(cap_cell(b, COL_CPU_BUSY, row), s->cpu_busy);
+    put_le64(cap_cell(b, COL_CPU_TOTAL, row), s->cpu_total);
+}
+
+// reads row row of the block at b back into s
+void cap_get_row(const unsigned char *b, long long row, struct sample *s){
+    unsigned char *c = (unsigned char *)b; //cap_cell only computes an address
+    s->t_ns = (long long)get_le64(cap_cell(c, COL_T_NS, row));
+    s->wall_ns = (long long)get_le64(cap_cell(c, COL_WALL_NS, row));
+    s->phys_used = get_le64(cap_cell(c, COL_PHYS_USED, row));
+    s->phys_total = get_le64(cap_cell(c, COL_PHYS_TOTAL, row));
+    s->phys_avail = get_le64(cap_cell(c, COL_PHYS_AVAIL, row));
+    s->swap_used = get_le64(cap_cell(c, COL_SWAP_USED, row));
+    s->swap_total = get_le64(cap_cell(c, COL_SWAP_TOTAL, row));
+    s->cpu_busy = get_le64(cap_cell(c, COL_CPU_BUSY, row));
+    s->cpu_total = get_le64(cap_cell(c, COL_CPU_TOTAL, row));
+}
+
+// returns 0 if the header at h describes a capture with the layout of this program, -1 otherwise
+int cap_check_header(const unsigned char *h){
+    uint64_t layout = get_le64(h + 8); //u16 version, u16 columns, u32 rows per block
+    if(memcmp(h, CAP_MAGIC, 8) != 0) return -1;
+    if((layout & 0xffff) != CAP_VERSION || (layout >> 16 & 0xffff) != CAP_COLS || layout >> 32 != CAP_BLOCK_ROWS) return -1;
+    return get_le64(h + 16) == cap_block_size() ? 0 : -1;
+}
+
+// a capture being recorded: the file and the mapping of the block rows are appended to
+struct capture {
+    int fd; //the capture file, -1 if not recording
+    unsigned char *block; //mapping of the last block
+    long long nblocks; //blocks in the file, the last one being the one mapped
+    long long last_seek; //seek time of the latest row, 0 if the capture has none
+    long long seek0, mono0; //seek time and monotonic time of the first sample of this session, seek0 is 0 before it
+};
+
+// unmaps the last block and closes the capture
+void capture_close(struct capture *cap){
+    if(cap->block) munmap(cap->block, cap_block_size());
+    if(cap->fd >= 0) close(cap->fd);
+    cap->block = NULL;
+    cap->fd = -1;
+}
+
+// maps block k of the capture for writing, growing the file first if the block is new; returns 0 on success
+int capture_map_block(struct capture *cap, long long k){
+    size_t size = cap_block_size();
+    off_t end = CAP_HEADER_SIZE + (off_t)(k + 1) * size;
+    struct stat st;
+    if(fstat(cap->fd, &st) < 0 || (st.st_size < end && ftruncate(cap->fd, end) < 0)) return -1; //the new block reads as zeros: no rows yet
+    cap->block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, CAP_HEADER_SIZE + (off_t)k * size);
+    if(cap->block == MAP_FAILED){
+        cap->block = NULL;
+        return -1;
+    }
+    cap->nblocks = k + 1;
+    return 0;
+}
+
+/*  opens the capture at path for appending, creating it with a header describing this machine if it is empty.
+ *   returns 0 on success and -1 with a message on stderr otherwise, with nothing left open.
+ */
+int capture_open(struct capture *cap, const char *path, long long interval_ns){
+    unsigned char h[CAP_HEADER_SIZE];
+    struct stat st;
+    size_t size = cap_block_size();
+
+    cap->block = NULL;
+    cap->last_seek = cap->seek0 = cap->mono0 = 0;
+    cap->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(cap->fd < 0 || fstat(cap->fd, &st) < 0){
+        fprintf(stderr, "Could not open the capture %s\n", path);
+        capture_close(cap);
+        return -1;
+    }
+
+    if(st.st_size == 0){ //a new capture: the header records where it was taken
+        struct utsname u;
+        uname(&u);
+        memset(h, 0, sizeof h);
+        memcpy(h, CAP_MAGIC, 8);
+        put_le64(h + 8, CAP_VERSION | (uint64_t)CAP_COLS << 16 | (uint64_t)CAP_BLOCK_ROWS << 32); //u16 version, u16 columns, u32 rows per block
+        put_le64(h + 16, size);
+        put_le64(h + 24, (uint64_t)interval_ns);
+        put_le64(h + 32, (uint64_t)sysconf(_SC_NPROCESSORS_ONLN));
+        put_le64(h + 40, (uint64_t)wall_ns());
+        const char *names[5] = {u.sysname, u.nodename, u.release, u.version, u.machine};
+        for(int k=0; k<5; k++) strncpy((char *)h + 64 + k * CAP_UNAME_LEN, names[k], CAP_UNAME_LEN - 1);
+        if(pwrite(cap->fd, h, sizeof h, 0) != (ssize_t)sizeof h || capture_map_block(cap, 0) < 0){
+            fprintf(stderr, "Could not write the capture %s\n", path);
+            capture_close(cap);
+            return -1;
+        }
+        return 0;
+    }
+
+    if(pread(cap->fd, h, sizeof h, 0) != (ssize_t)sizeof h || cap_check_header(h) < 0 || (st.st_size - CAP_HEADER_SIZE) % size != 0){
+        fprintf(stderr, "Not a capture written by --record: %s\n", path);
+        capture_close(cap);
+        return -1;
+    }
+    long long k = (st.st_size - CAP_HEADER_SIZE) / size; //an existing capture continues in its last block, or in a new one
+    for(long long j=k - 1; j>=0 && j>=k - 2; j--){ //the latest seek time, which this session's must not go below; only the last block can be empty
+        unsigned char bh[32];
+        if(pread(cap->fd, bh, sizeof bh, CAP_HEADER_SIZE + (off_t)j * size) == (ssize_t)sizeof bh && get_le64(bh) > 0){
+            cap->last_seek = (long long)get_le64(bh + 24);
+            break;
+        }
+    }
+    uint64_t next = 0; //number of the first row of a new block
+    if(k > 0 && capture_map_block(cap, k - 1) < 0){ //going on in a new block would number its rows from 0 again
+        fprintf(stderr, "Could not write the capture %s\n", path);
+        capture_close(cap);
+        return -1;
+    }
+    if(k > 0 && cap_rows(cap->block) == CAP_BLOCK_ROWS){
+        next = get_le64(cap->block + 8) + CAP_BLOCK_ROWS;
+        munmap(cap->block, size);
+        cap->block = NULL;
+    }
+    if(cap->block == NULL){
+        if(capture_map_block(cap, k) < 0){
+            fprintf(stderr, "Could not write the capture %s\n", path);
+            capture_close(cap);
+            return -1;
+        }
+        put_le64(cap->block + 8, next);
+    }
+    return 0;
+}
+
+/*  appends a sample to the capture. The row is written into the mapping before the row count of its block is
+ *   raised, so a reader of a capture being recorded never sees a partly written row. returns 0 on success.
+ */
+int capture_append(struct capture *cap, const struct sample *s){
+    if(cap->seek0 == 0){ //the first sample of the session anchors its seek times, after those already in the capture
+        cap->seek0 = s->wall_ns > cap->last_seek ? s->wall_ns : cap->last_seek + 1;
+        cap->mono0 = s->t_ns;
+    }
+    long long seek = cap->seek0 + (s->t_ns - cap->mono0); //follows the monotonic clock, so a step of the wall clock does not move it
+    if(seek < cap->last_seek) seek = cap->last_seek;
+    cap->last_seek = seek;
+
+    uint64_t rows = cap_rows(cap->block);
+    if(rows == CAP_BLOCK_ROWS){ //the block is full, the next one is added
+        uint64_t next = get_le64(cap->block + 8) + rows;
+        munmap(cap->block, cap_block_size());
+        cap->block = NULL;
+        if(capture_map_block(cap, cap->nblocks) < 0) return -1;
+        put_le64(cap->block + 8, next); //number of the first row of the block
+        rows = 0;
+    }
+    if(rows == 0) put_le64(cap->block + 16, (uint64_t)seek); //first seek time of the block
+    cap_put_row(cap->block, (long long)rows, s);
+    put_le64(cap_cell(cap->block, COL_SEEK_NS, (long long)rows), (uint64_t)seek);
+    put_le64(cap->block + 24, (uint64_t)seek); //last seek time of the block
+    cap_set_rows(cap->block, rows + 1); //publishes the row and the block times written above
+    return 0;
+}
+
+// a capture mapped read-only for replay
+struct capture_view {
+    const unsigned char *map; //the whole file
+    size_t size; //bytes mapped
+    long long nblocks; //number of blocks
+};
+
+// maps the capture at path read-only, returns 0 on success and -1 with a message on stderr otherwise
+int capture_view_open(struct capture_view *v, const char *path){
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    v->map = NULL;
+    if(fd < 0 || fstat(fd, &st) < 0){
+        fprintf(stderr, "File could not be opened\n");
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    if(st.st_size < CAP_HEADER_SIZE || (v->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED ||
+        cap_check_header(v->map) < 0){
+        fprintf(stderr, "Not a capture written by --record: %s\n", path);
+        if(v->map && v->map != MAP_FAILED) munmap((void *)v->map, st.st_size);
+        v->map = NULL;
+        close(fd);
+        return -1;
+    }
+    close(fd); //the mapping stays valid
+    v->size = st.st_size;
+    v->nblocks = (st.st_size - CAP_HEADER_SIZE) / cap_block_size(); //a block still being grown is ignored until it is complete
+    return 0;
+}
+
+// returns the address of block k of a mapped capture
+const unsigned char *cap_block(const struct capture_view *v, long long k){
+    return v->map + CAP_HEADER_SIZE + (size_t)k * cap_block_size();
+}
+
+/*  finds the first row whose seek time is at least t_ns: a binary search over the block headers, then over the
+ *   seek column of one block. Only O(log n) pages of the file are touched. stores the block and row into *block and
+ *   *row, which point past the last row if there is none.
+ */
+void capture_seek(const struct capture_view *v, long long t_ns, long long *block, long long *row){
+    long long lo = 0, hi = v->nblocks; //first block whose last timestamp is at least t_ns
+    while(lo < hi){
+        long long mid = lo + (hi - lo) / 2;
+        const unsigned char *b = cap_block(v, mid);
+        if(cap_rows(b) == 0 || (long long)get_le64(b + 24) >= t_ns) hi = mid;
+        else lo = mid + 1;
+    }
+    *block = lo;
+    *row = 0;
+    if(lo == v->nblocks) return;
+
+    const unsigned char *b = cap_block(v, lo);
+    long long rlo = 0, rhi = (long long)cap_rows(b);
+    while(rlo < rhi){
+        long long mid = rlo + (rhi - rlo) / 2;
+        if((long long)get_le64(cap_cell((unsigned char *)b, COL_SEEK_NS, mid)) >= t_ns) rhi = mid;
+        else rlo = mid + 1;
+    }
+    *row = rlo;
+}
+
+// returns the number of the row at block k, row row of a mapped capture (the number of rows if k is past the last block)
+long long cap_row_number(const struct capture_view *v, long long k, long long row){
+    if(k < v->nblocks) return (long long)get_le64(cap_block(v, k) + 8) + row;
+    if(v->nblocks == 0) return 0;
+    const unsigned char *b = cap_block(v, v->nblocks - 1);
+    return (long long)(get_le64(b + 8) + cap_rows(b));
+}
+
+// prints the machine a capture was taken on, from its header, like print_machine_info
+void print_capture_info(const unsigned char *h){
+    const char *labels[5] = {"System Name", "Machine Name", "Release", "Version", "Architecture"};
+    const int order[5] = {0, 1, 3, 2, 4}; //the order of print_machine_info
+    printf("### System Information (recorded) ###\n");
+    for(int k=0; k<5; k++){
+        int f = order[k];
+        printf(" %s = %.*s\n", labels[f], CAP_UNAME_LEN, (const char *)h + 64 + f * CAP_UNAME_LEN);
+    }
+    printf(" Number of cores = %llu\n", (unsigned long long)get_le64(h + 32));
+}
+
+/*  parses the argument of --from or --to: seconds since the epoch ("1792241885.5"), or an offset from the first
+ *   sample of the capture with the units of --tdelay ("+3600", "+90s", "+500ms"). returns nanoseconds since the
+ *   epoch, or -1 if the string is not a time.
+ */
+long long parse_time(const char *str, long long first_ns){
+    if(str[0] == '+'){
+        if(strcmp(str, "+0") == 0) return first_ns;
+        long long ns = parse_interval(str + 1);
+        return ns < 0 ? -1 : first_ns + ns;
+    }
+    char *end;
+    double secs = strtod(str, &end);
+    if(end == str || *end != '\0' || !isfinite(secs) || secs < 0 || secs > MAX_SECONDS) return -1; //nan, inf and huge values cannot be converted
+    return (long long)(secs * 1e9 + 0.5);
+}
+
+/*  re-renders (text) or re-exports (csv, jsonl, bin) the samples of a capture whose wall-clock time is between from
+ *   and to, without reading anything from /proc. Text frames are drawn one after the other as fast as they can be.
+ *   returns the exit status of the program.
+ */
+int replay_capture(const char *path, enum output_format fmt, const char *from, const char *to, int graphics, int sequential){
+    struct capture_view v;
+    if(capture_view_open(&v, path) < 0) return 1;
+
+    long long first_ns = v.nblocks && cap_rows(cap_block(&v, 0)) ? (long long)get_le64(cap_block(&v, 0) + 16) : 0;
+    long long from_ns = from ? parse_time(from, first_ns) : 0;
+    long long to_ns = to ? parse_time(to, first_ns) : LLONG_MAX;
+    if(from_ns < 0 || to_ns < 0){
+        fprintf(stderr, "Invalid time '%s'\n", from_ns < 0 ? from : to);
+        munmap((void *)v.map, v.size);
+        return 1;
+    }
+
+    long long k, row, end_k, end_row;
+    capture_seek(&v, from_ns, &k, &row); //first row of the window
+    capture_seek(&v, to_ns == LLONG_MAX ? to_ns : to_ns + 1, &end_k, &end_row); //first row after it
+    long long count = cap_row_number(&v, end_k, end_row) - cap_row_number(&v, k, row);
+    int rows = history_rows(count < HISTORY_MAX ? (int)count : 0, graphics); //the history window, as for live sampling
+
+    static struct out_stream os; //static because of the size of the buffer
+    struct sample_ring ring;
+    if(fmt == FORMAT_TEXT){
+        if(ring_init(&ring, rows + 1) < 0){
+            fprintf(stderr, "Out of memory\n");
+            munmap((void *)v.map, v.size);
+            return 1;
+        }
+        term.mode = sequential ? SCREEN_APPEND : SCREEN_DIFF;
+    } else {
+        os.fd = STDOUT_FILENO;
+        os.len = 0;
+        os.last_flush = now_ns();
+        encode_header(&os, fmt);
+    }
+
+    long long n = 0, base_usage = 0;
+    for(; k<v.nblocks && n<count && !os.error; k++, row=0){
+        const unsigned char *b = cap_block(&v, k);
+        long long nrows = (long long)cap_rows(b), seq0 = (long long)get_le64(b + 8);
+        for(; row<nrows && n<count && !os.error; row++, n++){
+            struct sample s;
+            cap_get_row(b, row, &s);
+
+            if(fmt != FORMAT_TEXT){
+                encode_sample(&os, fmt, seq0 + row, &s);
+                stream_tick(&os, now_ns());
+                continue;
+            }
+            ring_push(&ring, &s);
+            if(n == 0) base_usage = (int)sample_cpu_usage(&s);
+            char when[64];
+            time_t secs = (time_t)(s.wall_ns / 1000000000LL);
+            strftime(when, sizeof when, "%Y-%m-%d %H:%M:%S", localtime(&secs));
+            if(sequential) frame_printf(">>> iteration %lld -- sample %lld at %s\n", n, seq0 + row, when);
+            else frame_printf("Replay of %lld samples -- sample %lld at %s\n", count, seq0 + row, when);
+            frame_printf("---------------------------------------\n");
+            display_memory_line(sequential, rows, n, &ring, graphics);
+            frame_printf("Number of cores: %llu\n", (unsigned long long)get_le64(v.map + 32));
+            frame_printf(" total cpu use: %.2f%%\n", sample_cpu_usage(&s));
+            if(graphics) cpu_graphics(&ring, n, sequential, rows, (int)base_usage);
+            screen_flush(&term);
+        }
+    }
+    if(fmt == FORMAT_TEXT){
+        printf("---------------------------------------\n");
+        print_capture_info(v.map);
+        printf("---------------------------------------\n");
+        ring_free(&ring);
+        screen_free(&term);
+    } else if(stream_flush(&os) < 0){
+        fprintf(stderr, "Could not write the records: %s\n", strerror(os.error));
+        munmap((void *)v.map, v.size);
+        return 1;
+    }
+    munmap((void *)v.map, v.size);
+    return 0;
+}
+
+/*  stores the non-idle and total cpu time elapsed between two aggregate /proc/stat samples into s,
+ *   using the same split of the 7 fields as calculate_cpu_usage
+ */
+void set_cpu_delta(unsigned long prev[7], unsigned long cur[7], struct sample *s){
+    uint64_t busy_prev = (uint64_t)prev[0] + prev[1] + prev[2] + prev[5] + prev[6]; //user, nice, system, irq and softirq
+    uint64_t busy_cur = (uint64_t)cur[0] + cur[1] + cur[2] + cur[5] + cur[6];
+    uint64_t idle_prev = (uint64_t)prev[3] + prev[4]; //idle and iowait
+    uint64_t idle_cur = (uint64_t)cur[3] + cur[4];
+
+    s->cpu_busy = busy_cur - busy_prev;
+    s->cpu_total = s->cpu_busy + (idle_cur - idle_prev);
+}
+
+// copies the rows of src into dst, growing dst as needed
+void cpu_table_copy(struct cpu_table *dst, const struct cpu_table *src){
+    if(cpu_table_reserve(dst, src->n) < 0){
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memcpy(dst->id, src->id, src->n * sizeof *dst->id);
+    for(int f=0; f<CPU_FIELDS; f++) memcpy(dst->field[f], src->field[f], src->n * sizeof *dst->field[f]);
+    dst->n = src->n;
+}
+
+#define QUEUE_SLOTS 64 //snapshots a collector can publish before the renderer has to consume them
+
+/*  lock-free single-producer/single-consumer queue of fixed-size slots. The producer fills the slot returned by
+ *   spsc_claim and makes it visible with spsc_publish; the consumer reads slots with spsc_peek and frees them with spsc_pop.
+ */
+struct spsc_queue {
+    char *slots; //cap slots of slot_size bytes
+    size_t slot_size; //size of one slot in bytes
+    unsigned long cap; //number of slots
+    _Alignas(64) atomic_ulong head; //number of slots published, only written by the producer
+    _Alignas(64) atomic_ulong tail; //number of slots consumed, only written by the consumer
+};
+
+// allocates the zeroed slots of a queue, returns 0 on success and -1 on allocation failure
+int spsc_init(struct spsc_queue *q, size_t slot_size, unsigned long cap){
+    q->slots = calloc(cap, slot_size);
+    q->slot_size = slot_size;
+    q->cap = cap;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return q->slots ? 0 : -1;
+}
+
+// producer: returns the next free slot, or NULL if the consumer has not freed any
+void *spsc_claim(struct spsc_queue *q){
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&q->tail, memory_order_acquire); //the consumer is done with the slots before tail
+    if(head - tail == q->cap) return NULL;
+    return q->slots + (head % q->cap) * q->slot_size;
+}
+
+// producer: makes the slot returned by spsc_claim visible to the consumer
+void spsc_publish(struct spsc_queue *q){
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    atomic_store_explicit(&q->head, head + 1, memory_order_release); //the contents of the slot are written before head moves
+}
+
+// consumer: returns the k-th published slot not consumed yet (0 is the oldest), or NULL if there are not that many
+void *spsc_peek(struct spsc_queue *q, unsigned long k){
+    unsigned long tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if(tail + k >= head) return NULL;
+    return q->slots + ((tail + k) % q->cap) * q->slot_size;
+}
+
+// consumer: frees the oldest published slot for the producer
+void spsc_pop(struct spsc_queue *q){
+    unsigned long tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+// a thread that takes a timestamped snapshot of one source on every tick and publishes it into its own queue
+struct collector {
+    const char *name; //name printed in the statistics
+    int (*sample)(struct collector *c, void *slot); //fills a free queue slot with a new snapshot, returns 0 if there is nothing new to publish
+    void (*release)(void *slot); //frees what a slot owns when the pipeline stops, may be NULL
+    size_t slot_size; //size of one snapshot
+    long long limit; //number of published snapshots after which the collector stops by itself, 0 for no limit
+    int per_core; //cpu collector only: whether the per-core rows are read as well
+    int top_n; //top collector only: number of processes in each snapshot
+    enum stage stage; //histogram the duration of the sample callback goes to with --self-stats
+    sem_t *ready; //posted after every published snapshot, NULL if the renderer does not wait for this collector
+    struct spsc_queue queue; //snapshots waiting for the renderer
+    struct tick_clock sched; //schedule of the collector, started at the same time for all collectors
+    long long tick; //number of the snapshot being taken; snapshot 0 is taken immediately at start
+    long long published; //snapshots handed to the renderer; dropped ones do not count toward the limit
+    atomic_llong dropped; //snapshots lost because the renderer had not freed any slot
+    pthread_t thread;
+};
+
+// a cpu snapshot: the aggregate counters and, with --per-core, the counters of every core
+struct cpu_snapshot {
+    long long tick; //number of the snapshot
+    long long t_ns, wall_ns; //monotonic and wall-clock time of the snapshot
+    unsigned long agg[7]; //user, nice, system, idle, iowait, irq, softirq of the aggregate cpu line
+    struct cpu_table table; //per-core counters, owned by the queue slot and only filled with --per-core
+};
+
+// a memory snapshot
+struct mem_snapshot {
+    long long tick; //number of the snapshot
+    struct sample mem; //memory fields filled by write_memory
+    struct meminfo info; //the /proc/meminfo reading they were computed from
+};
+
+// collector callback: reads /proc/stat into a cpu snapshot
+int sample_cpu(struct collector *c, void *slot){
+    struct cpu_snapshot *cs = slot;
+    if(c->per_core){
+        read_cpu_table(&cs->table); //reads the aggregate and per-core counters in one pass over /proc/stat
+        cpu_table_row(&cs->table, 0, cs->agg);
+    } else {
+        set_cpu_values(cs->agg);
+    }
+    cs->tick = c->tick;
+    cs->t_ns = now_ns();
+    cs->wall_ns = wall_ns();
+    return 1;
+}
+
+// collector callback: frees the per-core table of a cpu snapshot slot
+void release_cpu(void *slot){
+    cpu_table_free(&((struct cpu_snapshot *)slot)->table);
+}
+
+// collector callback: reads the memory usage into a memory snapshot
+int sample_memory(struct collector *c, void *slot){
+    struct mem_snapshot *ms = slot;
+    write_memory(&ms->mem, &ms->info);
+    ms->mem.t_ns = now_ns();
+    ms->tick = c->tick;
+    return 1;
+}
+
+struct session_cache utmp_cache = {.path = _PATH_UTMP}; //the sessions of the system, only used by the sessions collector thread
+
+// collector callback: publishes the logged-in sessions, but only when the utmp file changed since the previous snapshot
+int sample_sessions(struct collector *c, void *slot){
+    struct session_list *list = slot;
+    if(session_cache_update(&utmp_cache) == 0 && c->tick > 0) return 0; //the renderer keeps showing the previous snapshot
+    session_list_copy(list, &utmp_cache.list);
+    list->tick = c->tick;
+    return 1;
+}
+
+// collector callback: frees the sessions of a session list slot
+void release_sessions(void *slot){
+    free(((struct session_list *)slot)->s);
+}
 
-    if(sequential){
-        printf(">>> iteration %d\n", i); //prints iteration number if sequential
-    } else {
-        printf("\033[H\033[2J"); //clears the terminal screen and move the cursor to the top-left corner
-        printf("Nbr of samples: %d -- every %d secs\n", samples, tdelay); //prints the number of samples and tdelay between samples
-    }
+// a top-N snapshot of the processes using the most cpu
+struct top_snapshot {
+    long long tick; //number of the snapshot
+    long long nprocs; //number of processes scanned
+    int n; //number of rows in e
+    struct top_entry *e; //the rows, owned by the queue slot
+};
 
-    struct rusage mem_usage; //declaring a struct of type rusage found in <sys/resource.h>
-    struct rusage *mem_ptr = &mem_usage; //creating pointer pointing to the address of mem_usage
+struct proc_scanner top_scanner; //the process scanner, only used by the top collector thread
 
-    if(getrusage(RUSAGE_SELF, mem_ptr)==0){ //checks if the call to getrusage is successful
-        printf(" Memory usage: %ld kilobytes\n", mem_ptr->ru_maxrss); //prints memory usage through ru_maxrss field of rusage struct
+// collector callback: scans /proc/[pid] and selects the processes using the most cpu
+int sample_top(struct collector *c, void *slot){
+    struct top_snapshot *ts = slot;
+    if(ts->e == NULL && (ts->e = malloc(c->top_n * sizeof *ts->e)) == NULL) return 0;
+
+    proc_scan(&top_scanner, now_ns());
+    ts->n = proc_top(&top_scanner, ts->e, c->top_n);
+    ts->nprocs = top_scanner.nprocs;
+    ts->tick = c->tick;
+    return 1;
+}
+
+// collector callback: frees the rows of a top-N snapshot slot
+void release_top(void *slot){
+    free(((struct top_snapshot *)slot)->e);
+}
+
+#define IO_DEV_MAX 128 //block devices or network interfaces kept in one I/O snapshot
+#define SECTOR_SIZE 512 //unit of the sector counts in /proc/diskstats, whatever the device
+
+// cumulative counters of one block device or network interface
+struct io_dev {
+    char name[32]; //device or interface name
+    uint64_t in_ops, in_bytes; //reads completed and bytes read, or packets and bytes received
+    uint64_t out_ops, out_bytes; //writes completed and bytes written, or packets and bytes sent
+};
+
+// an I/O snapshot: the counters of every device at one tick, in a fixed-size array so a slot never allocates
+struct io_snapshot {
+    long long tick; //number of the snapshot
+    long long t_ns; //monotonic time of the reading, the rates are computed between two of them
+    int n; //number of devices in dev
+    struct io_dev dev[IO_DEV_MAX];
+};
+
+struct proc_file proc_diskstats = {"/proc/diskstats", -1, NULL, 0, 0}; //persistent reader for /proc/diskstats
+struct proc_file proc_net_dev = {"/proc/net/dev", -1, NULL, 0, 0}; //persistent reader for /proc/net/dev
+
+// copies the name at *pp, which ends at a blank or at stop, into name and advances *pp past it
+void scan_name(const char **pp, char *name, size_t n, char stop){
+    const char *p = *pp;
+    size_t len = 0;
+    while(*p == ' ' || *p == '\t') p++;
+    for(; *p && *p != ' ' && *p != '\n' && *p != stop; p++){
+        if(len < n - 1) name[len++] = *p;
     }
+    name[len] = '\0';
+    *pp = p;
 }
 
-//  prints the number of currently available cores using sysconf
-void print_cores(void){
-    int n_cpu = sysconf(_SC_NPROCESSORS_ONLN); //sysconf returns the number of processors (found in <unistd.h>)
-    printf("Number of cores: %d\n", n_cpu); //printing number of cores to stdout
+/*  parses /proc/diskstats into s. each line is "major minor name" followed by the counters, of which the reads
+ *   completed, sectors read, writes completed and sectors written are kept. devices that never did any I/O
+ *   (unused loop and ram devices) are left out. returns the number of devices.
+ */
+int parse_diskstats(const char *buf, struct io_snapshot *s){
+    s->n = 0;
+    for(const char *p = buf; *p && s->n < IO_DEV_MAX; ){
+        struct io_dev *d = &s->dev[s->n];
+        scan_ull(&p); //major
+        scan_ull(&p); //minor
+        scan_name(&p, d->name, sizeof d->name, ' ');
+        d->in_ops = scan_ull(&p);
+        scan_ull(&p); //reads merged
+        d->in_bytes = scan_ull(&p) * SECTOR_SIZE;
+        scan_ull(&p); //time spent reading
+        d->out_ops = scan_ull(&p);
+        scan_ull(&p); //writes merged
+        d->out_bytes = scan_ull(&p) * SECTOR_SIZE;
+        if(d->name[0] && d->in_ops + d->out_ops > 0) s->n++;
+
+        const char *nl = strchr(p, '\n');
+        if(nl == NULL) break;
+        p = nl + 1;
+    }
+    return s->n;
 }
 
-/*  takes an array of unsigned long integers as parameter and set its entries to the values of user, 
- *   nice, system, idle, iowait, irq, softirq fields as found in the file /proc/stat
+/*  parses /proc/net/dev into s. after the two header lines, each line is "name:" followed by 8 receive and 8 transmit
+ *   counters, of which the bytes and packets of each direction are kept. returns the number of interfaces.
  */
-void set_cpu_values(unsigned long cpuArr[7])
-{
-    FILE *fp = fopen("/proc/stat", "r"); //opening /proc/stat file in read-mode and assigns the returned file pointer to fp
+int parse_net_dev(const char *buf, struct io_snapshot *s){
+    const char *p = buf;
+    s->n = 0;
+    for(int k=0; k<2 && p; k++){ //skips the header
+        p = strchr(p, '\n');
+        if(p) p++;
+    }
+    while(p && *p && s->n < IO_DEV_MAX){
+        struct io_dev *d = &s->dev[s->n];
+        scan_name(&p, d->name, sizeof d->name, ':');
+        if(*p == ':') p++;
+        d->in_bytes = scan_ull(&p);
+        d->in_ops = scan_ull(&p);
+        for(int k=0; k<6; k++) scan_ull(&p); //errs, drop, fifo, frame, compressed, multicast
+        d->out_bytes = scan_ull(&p);
+        d->out_ops = scan_ull(&p);
+        if(d->name[0]) s->n++;
 
-    if(fp==NULL){ //checks if file opening is successful
-        fprintf(stderr, "File could not be opened\n"); //if there was an error opening file, the message is printed to stderr
-        exit(1); //exit program
+        p = strchr(p, '\n');
+        if(p) p++;
     }
+    return s->n;
+}
 
-    char buffer[255]; //a char array used to store the format string
-    //fscanf is used to read data from the file into the variables
-    int success = fscanf(fp, "%s %lu %lu %lu %lu %lu %lu %lu", buffer, &(cpuArr[0]), &(cpuArr[1]), 
-        &(cpuArr[2]), &(cpuArr[3]), &(cpuArr[4]), &(cpuArr[5]), &(cpuArr[6])); 
-    //specifies that the function should read one string followed by seven unsigned long integers
+// collector callback: reads /proc/diskstats into an I/O snapshot
+int sample_disk(struct collector *c, void *slot){
+    struct io_snapshot *s = slot;
+    if(proc_read(&proc_diskstats) < 0) return 0;
+    parse_diskstats(proc_diskstats.buf, s);
+    s->t_ns = now_ns();
+    s->tick = c->tick;
+    return 1;
+}
 
-    if(success!=8){ //checks the number of items successfully read by fscanf
-        fprintf(stderr, "Error reading file\n");    //prints error message to stderr if error occurs
-        fclose(fp); //close file pointer
-        exit(1); //exit program
+// collector callback: reads /proc/net/dev into an I/O snapshot
+int sample_net(struct collector *c, void *slot){
+    struct io_snapshot *s = slot;
+    if(proc_read(&proc_net_dev) < 0) return 0;
+    parse_net_dev(proc_net_dev.buf, s);
+    s->t_ns = now_ns();
+    s->tick = c->tick;
+    return 1;
+}
+
+// what the renderer keeps of an I/O collector: the latest two snapshots, whose difference gives the rates
+struct io_view {
+    struct io_snapshot prev, cur; //copies, so the queue slots are freed right away
+    int have; //number of snapshots received, up to 2
+    double peak; //highest total bytes/s of a device so far, the full scale of the bars
+};
+
+// consumes the snapshots published by an I/O collector; the one before the latest is kept as the start of the interval
+void io_view_update(struct io_view *v, struct spsc_queue *q){
+    struct io_snapshot *s;
+    while((s = spsc_peek(q, 0)) != NULL){
+        if(v->have) v->prev = v->cur;
+        memcpy(&v->cur, s, sizeof *s);
+        if(v->have < 2) v->have++;
+        spsc_pop(q);
     }
-    fclose(fp); //close file pointer
 }
 
-/*
- *given two unsigned long arrays prev and cur representing the 7 fields of cpu information as obtained from
- * /proc/stat that were sampled at different times, it calculates and returns the cpu usage percentage.
+// returns the device of s with the given name, looking at index k first since devices rarely come and go, or NULL
+const struct io_dev *io_find(const struct io_snapshot *s, int k, const char *name){
+    if(k < s->n && strcmp(s->dev[k].name, name) == 0) return &s->dev[k];
+    for(int j=0; j<s->n; j++){
+        if(strcmp(s->dev[j].name, name) == 0) return &s->dev[j];
+    }
+    return NULL;
+}
+
+// returns the per-second rate of a counter that went from a to b in secs seconds (0 if the counter was reset)
+double io_rate(uint64_t a, uint64_t b, double secs){
+    return b >= a ? (b - a) / secs : 0.0;
+}
+
+/*  displays the rate of every device between the two latest snapshots of v, as operations and megabytes per second
+ *   in each direction. With graphics, a bar of the bytes/s follows, '#' for reads/receive and ':' for writes/transmit,
+ *   scaled to the busiest rate seen so far (bar width 40 by default, or --bar-width).
  */
-double calculate_cpu_usage(unsigned long prev[7], unsigned long cur[7])
-{
-    int idle_prev = prev[3] + prev[4];  //sum of the idle and iowait fields of /proc/stat in prev sample
-    int idle_cur = cur[3] + cur[4]; //sum of idle and and iowait fields of /proc/stat in cur sample
+void print_io(struct io_view *v, const char *title, const char *in, const char *out, const char *ops, int graphics){
+    frame_printf("### %s ###\n", title);
+    if(v->have < 2){
+        frame_printf(" (waiting for a second reading)\n");
+        return;
+    }
+    double secs = (v->cur.t_ns - v->prev.t_ns) / 1e9;
+    if(secs <= 0) secs = 1e-9;
+    int width = bars.width ? bars.width : 40;
 
-    int non_idle_prev = prev[0] + prev[1] + prev[2] + prev[5] + prev[6];    //sum of user, nice, system, irq, and softirq fields of /proc/stat in prev sample
-    int non_idle_cur = cur[0] + cur[1] + cur[2] + cur[5] + cur[6];  //sum of user, nice, system, irq, and softirq fields of /proc/stat in cur sample
+    for(int k=0; k<v->cur.n; k++){
+        const struct io_dev *d = &v->cur.dev[k];
+        const struct io_dev *p = io_find(&v->prev, k, d->name);
+        if(p == NULL) continue; //a device that just appeared has no interval yet
+        double in_ops = io_rate(p->in_ops, d->in_ops, secs), out_ops = io_rate(p->out_ops, d->out_ops, secs);
+        double in_bps = io_rate(p->in_bytes, d->in_bytes, secs), out_bps = io_rate(p->out_bytes, d->out_bytes, secs);
 
-    int total_prev = idle_prev + non_idle_prev; //sum of idle_prev and non_idle_prev, giving the total time of the CPU in prev sample
-    int total_cur = idle_cur + non_idle_cur; //sum of idle_prev and non_idle_prev, giving the total time of the CPU in cur sample
+        char *q = bar_row;
+        q += snprintf(q, 192, " %-10s %s %8.0f %s %9.2f MB/s -- %s %8.0f %s %9.2f MB/s", d->name,
+            in, in_ops, ops, in_bps / 1048576, out, out_ops, ops, out_bps / 1048576);
+        if(graphics){
+            if(in_bps + out_bps > v->peak) v->peak = in_bps + out_bps;
+            int n_in = v->peak > 0 ? bar_length(in_bps * bars.scale, v->peak, width) : 0;
+            int n_out = v->peak > 0 ? bar_length(out_bps * bars.scale, v->peak, width) : 0;
+            if(n_out > width - n_in) n_out = width - n_in;
+            q = put_bar(q, ' ', 3);
+            *q++ = '|';
+            q = put_bar(q, '#', n_in); //one memset per direction, like the memory and cpu bars
+            q = put_bar(q, ':', n_out);
+        }
+        *q++ = '\n';
+        frame_write(bar_row, q - bar_row);
+    }
+}
 
-    double total_diff = (double) total_cur - (double) total_prev; //difference between current and previous total CPU time values
-    double idle_diff = (double) idle_cur - (double) idle_prev; //difference between current and previous idle time values
+/*  body of a collector thread: samples on every tick of its clock until the limit is reached or the pipeline stops.
+ *   the limit counts published snapshots, not ticks: the renderer waits for limit snapshots, so one lost while the
+ *   queue was full must be made up by a later tick, or the renderer would wait forever.
+ */
+void *collector_main(void *arg){
+    struct collector *c = arg;
 
-    // total_diff - idle_diff gives the difference in CPU utilization between two points in time that excludes idle time,
-    // which gives a measure of how busy the CPU was with non_idle tasks between two sample points in time 
-    // (referred to as utilization of the CPU). Dividing this by the difference of total CPU time yields the fraction of
-    // CPU time spent on non_idle activities, which is then multiplied by 1000 to convert the decimals into a whole number and 1 
-    // is added to avoid division by 0 and to avoid undefined value. Then divided by 10 to get a range between 0-100% as percentage.
-    // Note: formula obtained from TAs in office hours linked in README file
-    return ((1000 * ((total_diff - idle_diff) / total_diff) + 1) / 10);
+    while(!stop_requested && (c->limit == 0 || c->published < c->limit)){
+        if(c->tick > 0){ //snapshot 0 is taken at once, every later one at its absolute deadline
+            tick_wait(&c->sched);
+            if(stop_requested) break;
+        }
 
+        void *slot = spsc_claim(&c->queue);
+        if(slot == NULL){ //the renderer is behind and every slot is taken, so this snapshot is lost
+            atomic_fetch_add(&c->dropped, 1);
+        } else {
+            long long t0 = self_stats ? raw_ns() : 0;
+            int fresh = c->sample(c, slot);
+            if(self_stats) hist_record(&stage_hist[c->stage], raw_ns() - t0);
+            if(fresh){
+                spsc_publish(&c->queue);
+                c->published++;
+                if(c->ready) sem_post(c->ready); //wakes the renderer
+            }
+        }
+        c->tick++;
+    }
+    return NULL;
 }
 
-// prints the current list of users/sessions on the system
-void print_users(void) {
+// allocates the queue of a collector and starts its thread with the first tick due one interval after start_ns
+int collector_start(struct collector *c, long long interval_ns, long long start_ns){
+    if(spsc_init(&c->queue, c->slot_size, QUEUE_SLOTS) < 0) return -1;
+    tick_start(&c->sched, interval_ns, start_ns);
+    c->tick = 0;
+    c->published = 0;
+    atomic_init(&c->dropped, 0);
+    return pthread_create(&c->thread, NULL, collector_main, c) == 0 ? 0 : -1;
+}
 
-    printf("### Sessions/users ###\n"); //prints a header
-    setutent(); //resets the internal stream of the utmp database to the beginning for reading utmp.h file
-    
-    for(struct utmp *user=NULL; (user=getutent());){ //read the records of the utmp database one by one until it returns a NULL pointer signalling the end
-        if(user->ut_type == USER_PROCESS){  //checks if the user is currently logged into the system and running a process
+// wakes a collector thread (stop_requested must be set already), waits for it to end and frees its queue
+void collector_stop(struct collector *c){
+    pthread_kill(c->thread, SIGUSR2); //interrupts the sleep so the thread sees stop_requested without waiting for its next tick
+    pthread_join(c->thread, NULL);
 
-            printf(" %s\t%s\t", user->ut_user, user->ut_line);  //prints username and terminal line stored in utmp struct
-            
-            if(*(user->ut_host)){  //checks whether the value of ut_host is non-empty
-                printf("(%s)", user->ut_host); //prints host information
+    for(unsigned long k=0; c->release && k<c->queue.cap; k++) c->release(c->queue.slots + k * c->queue.slot_size);
+    free(c->queue.slots);
+    c->queue.slots = NULL;
+}
+
+// measures the cost of one /proc/stat sample through the old fopen/fscanf path and through the persistent pread path
+int bench_sample(void){
+    const int iterations = 20000; //number of samples taken through each path
+    unsigned long cpu[7];
+    long long start, stdio_ns, pread_ns;
+
+    start = now_ns();
+    for(int k=0; k<iterations; k++) set_cpu_values_stdio(cpu); //fopen + fscanf + fclose on every sample
+    stdio_ns = now_ns() - start;
+
+    set_cpu_values(cpu); //opens /proc/stat once so that the timed loop only measures re-sampling
+    start = now_ns();
+    for(int k=0; k<iterations; k++) set_cpu_values(cpu); //pread into the reused buffer + integer scanner
+    pread_ns = now_ns() - start;
+
+    printf("### Benchmark: /proc/stat sample (%d iterations) ###\n", iterations);
+    printf(" fopen/fscanf: %8.0f ns/sample\n", (double)stdio_ns / iterations);
+    printf(" pread:        %8.0f ns/sample\n", (double)pread_ns / iterations);
+    printf(" speedup:      %8.2fx\n", (double)stdio_ns / (double)pread_ns);
+    return 0;
+}
+
+// times cpu_usage_kernel on synthetic tables with 1k and 4k cores
+int bench_cores(void){
+    const int sizes[] = {1024, 4096}; //simulated core counts
+    const int passes = 20000; //number of kernel passes per size
+
+    printf("### Benchmark: per-core usage kernel (%d passes) ###\n", passes);
+    for(int s=0; s<2; s++){
+        int n = sizes[s];
+        struct cpu_table prev = {0}, cur = {0};
+        double *usage = malloc(n * sizeof *usage);
+        if(usage == NULL || cpu_table_reserve(&prev, n) < 0 || cpu_table_reserve(&cur, n) < 0){
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        prev.n = cur.n = n;
+
+        uint64_t seed = 88172645463325252ULL; //xorshift state used to fill the counters
+        for(int r=0; r<n; r++){
+            prev.id[r] = cur.id[r] = r;
+            for(int f=0; f<CPU_FIELDS; f++){
+                seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+                prev.field[f][r] = seed >> 20; //large counters, as on a machine with a long uptime
+                cur.field[f][r] = prev.field[f][r] + (seed & 0xff); //advances each counter by up to 255 jiffies
             }
-            printf("\n");
         }
+
+        double checksum = 0.0;
+        long long start = now_ns();
+        for(int k=0; k<passes; k++){
+            cpu_usage_kernel(&prev, &cur, usage, n);
+            checksum += usage[k % n]; //keeps the compiler from dropping the passes
+        }
+        long long elapsed = now_ns() - start;
+
+        printf(" %5d cores: %10.0f ns/pass %6.2f ns/core (checksum %.1f)\n", n,
+            (double)elapsed / passes, (double)elapsed / passes / n, checksum);
+
+        cpu_table_free(&prev);
+        cpu_table_free(&cur);
+        free(usage);
     }
-    endutent(); //closes the internal stream of the utmp database
+    return 0;
 }
 
-//prints system information about the machine the program is running on
-void print_machine_info(void){
-    struct utsname sysData; //a struct of type utsname is declared (found in <sys/utsname.h>)
-    uname(&sysData); //fills in the fields of the sysData struct with information about the current Operating System
-    printf("### System Information ###\n");
-    printf(" System Name = %s\n", sysData.sysname); //prints system name
-    printf(" Machine Name = %s\n", sysData.nodename); //prints machine name
-    printf(" Version = %s\n", sysData.version); //prints OS version
-    printf(" Release = %s\n", sysData.release); //prints OS/software release
-    printf(" Architecture = %s\n", sysData.machine); //prints machine architecture (computer hardware type)
+// compares the bytes written and the time per frame of a full redraw and of the line-diff renderer over 1k graphical samples
+int bench_render(void){
+    const int n = 1000; //number of samples, and of rows in the history window
+    const enum screen_mode modes[] = {SCREEN_REDRAW, SCREEN_DIFF};
+    const char *names[] = {"full redraw", "line diff"};
+    struct sample_ring ring;
+
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC); //the frames are written to /dev/null so the terminal speed does not count
+    if(fd < 0 || ring_init(&ring, n) < 0){
+        fprintf(stderr, "Could not set up the render benchmark\n");
+        return 1;
+    }
+
+    printf("### Benchmark: render %d graphical samples ###\n", n);
+    for(int m=0; m<2; m++){
+        struct screen saved = term; //the benchmark uses the global frame, so its settings are restored afterwards
+        term.fd = fd;
+        term.mode = modes[m];
+        term.bytes = 0;
+        term.drawn = 0;
+        ring.count = 0;
+
+        uint64_t seed = 2463534242ULL; //xorshift state for the synthetic samples
+        long long start = now_ns(), flush = 0;
+        for(int i=0; i<n; i++){
+            struct sample s;
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            s.t_ns = i * 1000000000LL;
+            s.wall_ns = s.t_ns;
+            s.phys_total = 64ULL << 30;
+            s.phys_used = (16ULL << 30) + (seed % (1ULL << 30)); //between 16 and 17 GB used
+            s.phys_avail = s.phys_total - s.phys_used;
+            s.swap_total = 8ULL << 30;
+            s.swap_used = 0;
+            s.cpu_total = 100;
+            s.cpu_busy = seed % 101;
+            ring_push(&ring, &s);
+
+            display_header(i, 0, n, 1.0);
+            display_memory_line(0, n, i, &ring, 1);
+            cpu_graphics(&ring, i, 0, n, (int)sample_cpu_usage(ring_get(&ring, 0)));
+            long long f0 = now_ns();
+            screen_flush(&term);
+            flush += now_ns() - f0;
+        }
+        long long elapsed = now_ns() - start;
+
+        //the frame is assembled the same way in both modes; only the flush differs
+        printf(" %-12s %12lld bytes total %9.0f bytes/frame %8.1f us/frame, of which flush %6.1f us\n", names[m],
+            term.bytes, (double)term.bytes / n, elapsed / 1e3 / n, flush / 1e3 / n);
+
+        screen_free(&term);
+        term = saved;
+    }
+
+    ring_free(&ring);
+    close(fd);
+    return 0;
 }
 
-// stores calculated physical and virtual memory information as a string in strArr at index i and returns virtual used memory
-double write_memory(char strArr[][1024], int i){
-    struct sysinfo sys_info;    //a struct of type sysinfo is declared to store system information (from <sys/sysinfo.h>)
-    double phys_used, phys_total, virt_used, virt_total; 
-    
-    sysinfo(&sys_info); //retrieves information about the system into sys_info
+// times a scan of a synthetic utmp file with 10k records through getutent, through the mmap parser, and through the unchanged cache
+int bench_users(void){
+    const int records = 10000; //records in the synthetic utmp file, every fourth one a logged-in session
+    const int iterations = 200; //scans per path
+    char path[] = "/tmp/mySystemStats-utmp-XXXXXX";
 
-    //physical memory used calculated by subtracting free physical memory from the total physical memory and converting to gigabytes
-    phys_used = (float)(sys_info.totalram - sys_info.freeram)/1024/1024/1024; 
-    phys_total = (float)sys_info.totalram/1024/1024/1024; //storing total physical memory and dividing to convert the value to gigabytes
-    
-    //virtual memory used calculated by adding the used physical memory to the used virtual memory obtained by subtracting the free virtual memory
-    //from the total virtual memory and dividing by 1024^3 to convert it to gigabytes.
-    virt_used = phys_used + (float)(sys_info.totalswap - sys_info.freeswap) /1024/1024/1024;
-    
-    virt_total = (float)(sys_info.totalram + sys_info.totalswap)/1024/1024/1024; //total virtual memory calculated by adding total physical memory to total virtual memory
+    int fd = mkstemp(path);
+    if(fd < 0){
+        fprintf(stderr, "Could not create the synthetic utmp file\n");
+        return 1;
+    }
+    for(int k=0; k<records; k++){
+        struct utmp u;
+        memset(&u, 0, sizeof u);
+        u.ut_type = (k % 4 == 0) ? USER_PROCESS : DEAD_PROCESS;
+        u.ut_pid = 1000 + k;
+        snprintf(u.ut_line, sizeof u.ut_line, "pts/%d", k);
+        snprintf(u.ut_user, sizeof u.ut_user, "user%d", k % 500);
+        snprintf(u.ut_host, sizeof u.ut_host, "10.0.%d.%d", k / 256 % 256, k % 256);
+        if(write(fd, &u, sizeof u) != (ssize_t)sizeof u){
+            fprintf(stderr, "Could not write the synthetic utmp file\n");
+            close(fd);
+            unlink(path);
+            return 1;
+        }
+    }
+    close(fd);
 
-    sprintf(strArr[i], "%.2f GB / %.2f GB -- %.2f GB / %.2f GB",  
-    phys_used, phys_total, virt_used, virt_total); //store the calculated physical and virtual memory information as a string into strArr at index i
-    
-    return virt_used; //returns the virtual used memory
+    struct session_list list = {0};
+    long long start, getutent_ns, mmap_ns, cached_ns;
+
+    utmpname(path); //points the getutent functions at the synthetic file
+    start = now_ns();
+    for(int k=0; k<iterations; k++) read_sessions(&list);
+    getutent_ns = now_ns() - start;
+    utmpname(_PATH_UTMP);
+    int found = list.n;
+
+    start = now_ns();
+    for(int k=0; k<iterations; k++) parse_utmp_file(path, &list);
+    mmap_ns = now_ns() - start;
+
+    struct session_cache cache = {.path = path};
+    session_cache_update(&cache); //the first call parses, every timed call only stat()s the unchanged file
+    start = now_ns();
+    for(int k=0; k<iterations; k++) session_cache_update(&cache);
+    cached_ns = now_ns() - start;
+
+    printf("### Benchmark: %d-record utmp file, %d sessions (%d iterations) ###\n", records, found, iterations);
+    printf(" getutent:     %10.0f ns/scan\n", (double)getutent_ns / iterations);
+    printf(" mmap parse:   %10.0f ns/scan\n", (double)mmap_ns / iterations);
+    printf(" cached:       %10.0f ns/scan (%lld parses)\n", (double)cached_ns / iterations, cache.parses);
+
+    free(list.s);
+    free(cache.list.s);
+    unlink(path);
+    return found == list.n ? 0 : 1; //both parsers must find the same sessions
 }
 
-// modifies a string representation of the virtual memory usage of the system for future printing use
-void modify_memory_graphics(int i, double virt_used, double *prev_virt, char strArr[][1024]){
-    
-    char line[1024]="\0", temp[1024]="\0"; // initialize empty strings
-    int iter=0;
-    double diff=0.00;
+// writes a synthetic /proc/[pid]/stat file with the given cpu time into the directory dir, returns 0 on success
+int write_fake_stat(const char *dir, int pid, unsigned long long ticks){
+    char path[256], line[256];
+    snprintf(path, sizeof path, "%s/%d/stat", dir, pid);
+    int len = snprintf(line, sizeof line, "%d (proc %d) S 1 %d %d 0 -1 4194304 10 0 0 0 %llu %llu 0 0 20 0 1 0 100 1000000 250\n",
+        pid, pid, pid, pid, ticks / 2, ticks - ticks / 2);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); //rewritten in place, so descriptors held by the scanner see the new contents
+    if(fd < 0) return -1;
+    int ok = write(fd, line, len) == len;
+    close(fd);
+    return ok ? 0 : -1;
+}
 
-    strcpy(line, "   |");
-    
-    if(i==0)
-        diff=0.00; //on first iteration, set diff to 0 since no previous iteration exists
-    else
-        diff=virt_used - *(prev_virt); //calculates the difference between the current virtual memory usage and the previous usage
-    
-    if(diff>=0.00 && diff<0.01){
-        strcat(line, "o "); //if the differenece is nonnegative and less than 0.01 GB, then "o" is concatenated to 'line'
-    } else if (diff<0 && diff>-0.01){
-        strcat(line, "@ "); //if the difference is negative and greater than -0.01 GB, then "@" is concatenated to 'line'
+// writes a synthetic stat file holding only the fork counter into the directory dir, returns 0 on success
+int write_fork_count(const char *dir, int forks){
+    char path[256], line[64];
+    snprintf(path, sizeof path, "%s/stat", dir);
+    int len = snprintf(line, sizeof line, "cpu  0 0 0 0 0 0 0\nprocesses %d\n", forks);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) return -1;
+    int ok = write(fd, line, len) == len;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+// returns the user + system cpu time used by the program so far, in nanoseconds
+long long cpu_time_ns(void){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+/*  times the process scanner and the top-N selection on a synthetic /proc tree of 50k processes: 10 busy on every scan
+ *   and a different 1% of the others busy on each scan. returns 1 unless the top 10 are the steadily busy processes with
+ *   their exact usage on every scan, and a scan costs under 10 ms of cpu (1% of one core at 1 Hz).
+ */
+int bench_top(void){
+    const int nprocs = 50000; //processes in the synthetic tree
+    const int scans = 20; //timed scans
+    const int top_n = 10;
+    char root[] = "/tmp/mySystemStats-proc-XXXXXX";
+    char path[256];
+    int status = 0;
+
+    if(mkdtemp(root) == NULL){
+        fprintf(stderr, "Could not create the synthetic /proc tree\n");
+        return 1;
+    }
+    printf("### Benchmark: top-%d of %d synthetic processes (%d scans) ###\n", top_n, nprocs, scans);
+    if(write_fork_count(root, nprocs) < 0) status = 1;
+    for(int pid=1; pid<=nprocs && status == 0; pid++){
+        snprintf(path, sizeof path, "%s/%d", root, pid);
+        if(mkdir(path, 0755) < 0 || write_fake_stat(root, pid, 1000) < 0) status = 1;
+        snprintf(path, sizeof path, "%s/%d/statm", root, pid);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fd < 0 || write(fd, "25000 1200 800 10 0 900 0\n", 26) != 26) status = 1;
+        if(fd >= 0) close(fd);
+    }
+
+    struct proc_scanner ps;
+    struct top_entry top[10];
+    long clk_tck = sysconf(_SC_CLK_TCK);
+    int steady[10]; //processes busy on every scan, pid steady[j] at 6 + j ticks per second, far apart in the table
+    for(int j=0; j<10; j++) steady[j] = 100 * (1 + 50 * j);
+    if(status == 0 && proc_scanner_init(&ps, root) == 0){
+        //the scans run back to back, but are given the times of a 1 Hz sampling so that the usage is the one shown live
+        long long t = 0;
+        int g = 0; //scans so far; each 1% of the other processes is busy on one scan at most, from 1000 to 1005 ticks
+        int warm = 0; //scans until the first directory pass is over and the rotation has read every process once
+        for(int left = nprocs / PROC_ROTATE_READS + 2; left > 0; warm++){
+            for(int j=0; j<10; j++) write_fake_stat(root, steady[j], 1000 + (6 + j) * g);
+            proc_scan(&ps, t += 1000000000LL);
+            g++;
+            if(!ps.listing) left--;
+        }
+
+        for(int forking=0; forking<2; forking++){ //first without new processes, then with the fork counter moving on every scan
+            long long wall = 0, cpu = 0;
+            int shown = 0, wrong = 0;
+            for(int k=0; k<scans; k++, g++){
+                for(int pid=1 + g % 100; pid<=nprocs; pid+=100) write_fake_stat(root, pid, 1005); //a different 1% of the processes is busy on every scan
+                for(int j=0; j<10; j++) write_fake_stat(root, steady[j], 1000 + (6 + j) * g);
+                if(forking) write_fork_count(root, nprocs + k + 1);
+
+                long long w0 = now_ns(), c0 = cpu_time_ns();
+                proc_scan(&ps, t += 1000000000LL);
+                shown = proc_top(&ps, top, top_n);
+                wall += now_ns() - w0;
+                cpu += cpu_time_ns() - c0;
+
+                //the steady processes are re-read on every scan, so they are the top 10 with their exact usage; a process
+                //busy for one scan is only seen when the rotation reaches it, at 5 ticks averaged over a second or more
+                int ok = shown == top_n;
+                for(int a=0; ok && a<top_n; a++)
+                    ok = top[a].pid == steady[9 - a] && fabs(top[a].cpu - 100.0 * (15 - a) / clk_tck) < 1e-6;
+                if(!ok) wrong++;
+            }
+
+            double per_scan = cpu / 1e6 / scans; //ms of cpu per scan, which is the % of one core at 1 Hz divided by 10
+            printf("%s\n", forking ? " fork counter changing (directory listed in chunks):" : " no new processes (directory listing skipped):");
+            printf("  processes found:  %lld (%d stat descriptors held open, %d warm-up scans)\n", ps.nprocs, ps.open_fds, warm);
+            printf("  wall time:        %8.2f ms/scan\n", wall / 1e6 / scans);
+            printf("  cpu time:         %8.2f ms/scan = %.2f%% of one core at 1 Hz (target: under 1%%)\n", per_scan, per_scan / 10);
+            printf("  top process:      %d (%s) %.1f%%, %d of %d scans wrong\n", shown ? top[0].pid : 0, shown ? top[0].comm : "-",
+                shown ? top[0].cpu : 0.0, wrong, scans);
+            if(wrong || per_scan >= 10) status = 1; //the benchmark fails if the view is wrong or the scan misses the target
+        }
+        proc_scanner_free(&ps);
     } else {
-        iter = fabs((int) ((diff-(int)diff+0.005)*100)); //otherwise, stores the first two decimal places of the difference into a variable as an integer
-        
-        if(diff<0){
-            for(int i=0; i<iter; i++) {strcat(line, ":");} //if difference is negative, the loop concatenates ':' to 'line' ('iter' number of times)
-            strcat(line, "@ "); //then concatenates "@ " to the string
-        } else {
-            for(int i=0; i<iter; i++) {strcat(line, "#");} //if difference is nonnegative, the loop concatenates '#' to 'line' ('iter' number of times)
-            strcat(line, "* "); //then concatenates "* " to the string
-        }  
+        fprintf(stderr, "Could not set up the synthetic /proc tree\n");
+        status = 1;
+    }
 
+    for(int pid=1; pid<=nprocs; pid++){ //removes the synthetic tree
+        snprintf(path, sizeof path, "%s/%d/stat", root, pid);
+        unlink(path);
+        snprintf(path, sizeof path, "%s/%d/statm", root, pid);
+        unlink(path);
+        snprintf(path, sizeof path, "%s/%d", root, pid);
+        rmdir(path);
     }
+    snprintf(path, sizeof path, "%s/stat", root);
+    unlink(path);
+    rmdir(root);
+    return status;
+}
 
-    *(prev_virt)=virt_used; //the value of virt_used memory is stored in prev_virt for future calculation/use of prev_virt in the upcoming iterations of sampling
-    sprintf(temp, "%.2f (%.2f)", diff, virt_used); //stores the difference of virtual memory (prev and cur) and virtual used memory into the 'temp' string 
-    strcat(line, temp); //concatenates temp to line
-    strcat(strArr[i], line); //'line' string that has been formatted is concatenated to strArr at the current iteration index passed from main
-    
+/*  parses /proc/meminfo the usual way, for comparison in bench_meminfo: sscanf on every line and a linear search of
+ *   the key among the known ones. returns the number of known fields found.
+ */
+int parse_meminfo_scanf(const char *buf, struct meminfo *mi){
+    char key[64];
+    unsigned long long v;
+    int found = 0;
+
+    memset(mi, 0, sizeof *mi);
+    for(const char *p = buf; *p; ){
+        if(sscanf(p, "%63[^:]: %llu", key, &v) == 2){
+            for(int f=0; f<MI_FIELDS; f++){
+                if(strcmp(key, meminfo_keys[f]) == 0){
+                    mi->v[f] = strstr(p, " kB\n") == strchr(p, '\n') - 3 ? v * 1024 : v;
+                    mi->found |= 1u << f;
+                    found++;
+                    break;
+                }
+            }
+        }
+        const char *nl = strchr(p, '\n');
+        if(nl == NULL) break;
+        p = nl + 1;
+    }
+    return found;
+}
+
+// measures the parse throughput of /proc/meminfo with the perfect-hash parser against sscanf, and the cost of a full sample
+int bench_meminfo(void){
+    const int iterations = 200000; //parses of the same buffer through each parser
+    struct meminfo mi, ref;
+    long long start, scanf_ns, hash_ns, read_ns;
+
+    if(proc_read(&proc_meminfo) < 0){
+        fprintf(stderr, "File could not be opened\n");
+        return 1;
+    }
+    size_t len = proc_meminfo.len;
+    char *copy = malloc(len + 1); //a private copy, so the timed loops parse the same bytes
+    if(copy == NULL) return 1;
+    memcpy(copy, proc_meminfo.buf, len + 1);
+    int lines = 0;
+    for(size_t k=0; k<len; k++) lines += copy[k] == '\n';
+
+    int fields = parse_meminfo_scanf(copy, &ref);
+    start = now_ns();
+    for(int k=0; k<iterations; k++) parse_meminfo_scanf(copy, &mi);
+    scanf_ns = now_ns() - start;
+
+    parse_meminfo(copy, len, &mi); //builds the key table outside the timed loop
+    start = now_ns();
+    for(int k=0; k<iterations; k++) parse_meminfo(copy, len, &mi);
+    hash_ns = now_ns() - start;
+
+    int same = memcmp(mi.v, ref.v, sizeof mi.v) == 0 && mi.found == ref.found; //both parsers must agree
+    start = now_ns();
+    for(int k=0; k<iterations / 10; k++) read_meminfo(&mi); //pread of the live file + parse
+    read_ns = now_ns() - start;
+
+    printf("### Benchmark: /proc/meminfo parse (%d lines, %zu bytes, %d fields kept, %d iterations) ###\n", lines, len, fields, iterations);
+    printf(" sscanf + strcmp: %8.0f ns/parse = %7.1f MB/s\n", (double)scanf_ns / iterations, len * 1e3 * iterations / scanf_ns);
+    printf(" perfect hash:    %8.0f ns/parse = %7.1f MB/s (%.1f ns/line)\n", (double)hash_ns / iterations,
+        len * 1e3 * iterations / hash_ns, (double)hash_ns / iterations / lines);
+    printf(" speedup:         %8.2fx\n", (double)scanf_ns / hash_ns);
+    printf(" pread + parse:   %8.0f ns/sample\n", (double)read_ns / (iterations / 10));
+    free(copy);
+    if(!same) fprintf(stderr, "The parsers disagree\n");
+    return same ? 0 : 1;
+}
+
+// the cpu graphics rows as originally built, one strcat per bar, for comparison in bench_bars
+void cpu_graphics_strcat(const struct sample_ring *ring, long long i, int rows, int base_usage){
+    char row[BAR_ROW_SIZE];
+    for(long long j=i - rows + 1 < 0 ? 0 : i - rows + 1; j<=i; j++){
+        double usage = sample_cpu_usage(ring_get(ring, j));
+        int num_bar = 3 + (int)usage - base_usage;
+        strcpy(row, "         ");
+        for(int m=0; m<num_bar && m<BAR_MAX; m++) strcat(row, "|"); //rescans the row for every bar
+        sprintf(row + strlen(row), "%.2f", usage);
+        frame_printf("%s\n", row);
+    }
+}
+
+/*  times building the cpu graphics of a 10k-row window at 100% cpu with strcat, with the memset builder, with bars
+ *   scaled to 1000 characters, and as a sparkline of the latest 1000 samples
+ */
+int bench_bars(void){
+    const int n = 10000; //rows of the window
+    const int frames = 20; //frames built through each path
+    const char *names[] = {"strcat", "memset", "memset, 1000 wide", "sparkline, 1000"};
+    struct sample_ring ring;
+
+    if(ring_init(&ring, n) < 0){
+        fprintf(stderr, "Could not set up the bars benchmark\n");
+        return 1;
+    }
+    for(int k=0; k<n; k++){
+        struct sample s = {0};
+        s.cpu_total = s.cpu_busy = 100; //every sample at 100% cpu
+        ring_push(&ring, &s);
+    }
+
+    printf("### Benchmark: cpu graphics of %d rows at 100%% cpu (%d frames) ###\n", n, frames);
+    struct bar_style saved = bars;
+    for(int m=0; m<4; m++){
+        bars.width = m >= 2 ? 1000 : 0;
+        bars.spark = m == 3;
+        size_t bytes = 0;
+        long long start = now_ns();
+        for(int f=0; f<frames; f++){
+            term.len = 0; //the rows are only assembled, nothing is written
+            if(m == 0) cpu_graphics_strcat(&ring, n - 1, n, 0);
+            else cpu_graphics(&ring, n - 1, 0, n, 0);
+            bytes = term.len;
+        }
+        long long elapsed = now_ns() - start;
+        int drawn = m == 3 ? bars.width : n; //a sparkline draws one block for each of the latest width samples
+        printf(" %-18s %8.3f ms/frame %8.1f ns/sample %9zu bytes/frame\n", names[m], elapsed / 1e6 / frames, (double)elapsed / frames / drawn, bytes);
+    }
+
+    //the original memory bars draw one character per 0.01 GB of change
+    const double diffs[] = {0.02, 0.05, 0.25, 1.25, -0.05, 20.0};
+    const int expected[] = {2, 5, 25, 125, 5, BAR_MAX};
+    int status = 0;
+    bars.width = 0;
+    bars.spark = 0;
+    for(int k=0; k<6; k++){
+        struct sample prev = {0}, cur = {0};
+        prev.phys_used = 32ULL << 30;
+        cur.phys_used = prev.phys_used + (uint64_t)llround(diffs[k] * (1ULL << 30));
+        bar_row[0] = '\0';
+        modify_memory_graphics(bar_row, sizeof bar_row, &cur, &prev);
+        int len = (int)strspn(bar_row + 4, diffs[k] < 0 ? ":" : "#"); //the bar follows the "   |" separator
+        printf(" memory bar for %+6.2f GB: %4d characters (expected %d)\n", diffs[k], len, expected[k]);
+        if(len != expected[k]) status = 1;
+    }
+    bars = saved;
+    term.len = 0;
+    ring_free(&ring);
+    return status;
 }
 
-//displays memory usage information stored in an array of strings 'strArr' according to sequential flag
-void display_memory_line(int sequential, int samples, int i, char strArr[][1024]){
-    int j=0;
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n"); //prints header
+/*  measures what timing a stage costs: the same /proc/stat sample as the cpu collector, with --self-stats off
+ *   (one branch) and on (two clock reads and a histogram update)
+ */
+int bench_stages(void){
+    const int iterations = 200000;
+    unsigned long cpu[7];
+    long long elapsed[2];
+    int saved = self_stats;
 
-    if(sequential){ //checks if sequential is true (i.e: 1)
-        for(j=0; j<samples; j++){ //goes through all the elements in strArr
-            if(j==i) //if the current iternation index equals the current index samples loop from main 
-                printf("%s\n", strArr[j]); //then the corresponding current memory information stored in strArr at the index is printed
-            else
-                printf("\n"); //otherwise fill the lines with a new line
+    for(int k=0; k<iterations; k++) set_cpu_values(cpu); //opens /proc/stat and warms up outside the timed loops
+    for(int on=0; on<2; on++){
+        self_stats = on;
+        long long start = now_ns();
+        for(int k=0; k<iterations; k++){
+            long long t0 = self_stats ? raw_ns() : 0;
+            set_cpu_values(cpu);
+            if(self_stats) hist_record(&stage_hist[STAGE_CPU], raw_ns() - t0);
         }
-    } else {
-        for(j=0; j<=i; j++) printf("%s\n", strArr[j]); //if sequential is false, prints all the elements in strArr upto the current index 'i' passed from main
-        for(int k=j+1; k<=samples; k++) printf("\n"); //fills the rest of the lines with a new line until it reaches # of samples
+        elapsed[on] = now_ns() - start;
     }
+    self_stats = saved;
+
+    long long t0 = now_ns();
+    for(int k=0; k<iterations; k++) hist_record(&stage_hist[STAGE_RENDER], raw_ns() - t0); //the instrumentation alone
+    long long alone = now_ns() - t0;
+
+    printf("### Benchmark: stage timing overhead (%d /proc/stat samples) ###\n", iterations);
+    printf(" --self-stats off: %8.1f ns/sample\n", (double)elapsed[0] / iterations);
+    printf(" --self-stats on:  %8.1f ns/sample\n", (double)elapsed[1] / iterations);
+    printf(" clock + record:   %8.1f ns\n", (double)alone / iterations);
+    printf(" cpu read p50 %.1f us, p99 %.1f us\n", hist_percentile(&stage_hist[STAGE_CPU], 0.50) / 1e3, hist_percentile(&stage_hist[STAGE_CPU], 0.99) / 1e3);
+    return 0;
 }
 
-//  updates and displays the current CPU usage graphics in a graphical format
-void cpu_graphics(char cpuArr[][200], int i, int sequential, int *num_bar, float cur_cpu_usage, float *prev_cpu_usage){
-    int diff_bar=0; //initialize a variable that records the difference in bars ("|") between iterations
-    char cpuStr[200]="\0"; //initialize an empty string
+/*  records a synthetic week of 1 Hz samples into a capture, with the wall clock stepped back an hour on the way, then
+ *   times seeking to a one-hour window in the middle and reading it, and a scan of the cpu columns of the whole week,
+ *   both through the read-only mapping
+ */
+int bench_replay(void){
+    const long long week = 7 * 24 * 3600; //samples in a week at 1 Hz
+    const long long hour = 3600;
+    char path[] = "/tmp/mySystemStats-capture-XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0){
+        fprintf(stderr, "Could not create the synthetic capture\n");
+        return 1;
+    }
+    close(fd);
 
-    if(i==0){
-        sprintf(cpuArr[i], "         |||%.2f", cur_cpu_usage); //on first iteration, stores default of 3 bars followed by current cpu usage into first element of cpuArr
-    } else {
-        diff_bar = (int)cur_cpu_usage - (int)(*(prev_cpu_usage)); //otherwise, calculates the difference in CPU usage between prev and cur iterations (only looking at the integer part)
-        *(num_bar) += diff_bar; //updates the current 'num_bar' value with the new difference in number of bars calculated above
-        strcpy(cpuArr[i], "         "); //copies space into cpuArr at index i
-        
-        for(int m=0; m<*(num_bar); m++) {
-            strcat(cpuArr[i], "|"); //appends the number of bars represented by 'num_bar' and writes to cpuArr at index i
+    struct capture cap;
+    long long t0 = 1700000000LL * 1000000000LL; //wall-clock time of the first sample
+    long long step = hour * 1000000000LL;
+    long long start = now_ns();
+    if(capture_open(&cap, path, 1000000000LL) < 0){
+        unlink(path);
+        return 1;
+    }
+    uint64_t seed = 88172645463325252ULL; //xorshift state for the synthetic samples
+    for(long long k=0; k<week; k++){
+        struct sample s;
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        s.t_ns = k * 1000000000LL;
+        s.wall_ns = t0 + s.t_ns - (k >= week / 4 ? step : 0); //the wall clock is stepped back an hour a quarter into the week
+        s.phys_total = 64ULL << 30;
+        s.phys_avail = (40ULL << 30) + seed % (1ULL << 30);
+        s.phys_used = s.phys_total - s.phys_avail;
+        s.swap_total = 8ULL << 30;
+        s.swap_used = 0;
+        s.cpu_total = 100;
+        s.cpu_busy = seed % 101;
+        if(capture_append(&cap, &s) < 0){
+            fprintf(stderr, "Could not write the synthetic capture\n");
+            capture_close(&cap);
+            unlink(path);
+            return 1;
         }
-        sprintf(cpuStr, "%.2f", cur_cpu_usage); //writes the current cpu usage upto 2 decimal places into cpuStr string
-        strcat(cpuArr[i], cpuStr); //concatenates cpuStr into the already graphically formatted string of cpuArr at index i
     }
+    capture_close(&cap);
+    long long write_ns = now_ns() - start;
 
-    if(sequential){ //checks if sequential is true (i.e. 1)
-        for(int j=0; j<=i; j++){ //then iterate through the cpuArr upto the current iteration index i from main
-            if(j==i) //if index j matches the current iteration index i from main
-                printf("%s\n", cpuArr[j]); //prints the current iteration of cpuArr at index j
-            else
-                printf("\n"); //otherwise leave the rest blank (i.e. fill in the links with a new line)
+    struct capture_view v;
+    start = now_ns();
+    if(capture_view_open(&v, path) < 0){
+        unlink(path);
+        return 1;
+    }
+    long long k, row, n = 0;
+    uint64_t busy = 0;
+    capture_seek(&v, t0 + week / 2 * 1000000000LL, &k, &row); //the middle of the week
+    long long seek_ns = now_ns() - start;
+    long long found = cap_row_number(&v, k, row); //the seek times ignore the clock step, so this is sample week / 2
+    for(; k<v.nblocks && n<hour; k++, row=0){ //reads the hour that follows, every column of every row
+        const unsigned char *b = cap_block(&v, k);
+        for(long long nrows = (long long)cap_rows(b); row<nrows && n<hour; row++, n++){
+            struct sample s;
+            cap_get_row(b, row, &s);
+            busy += s.cpu_busy;
         }
-    } else { //if sequential is false
-        for(int h=0; h<=i; h++){ //iterate through cpuArr upto the current iteration index i from main
-            printf("%s\n", cpuArr[h]); //prints the entire cpuArr upto and including the current iteration
+    }
+    long long window_ns = now_ns() - start;
+
+    start = now_ns();
+    uint64_t sum_busy = 0, sum_total = 0;
+    for(k=0; k<v.nblocks; k++){ //a columnar scan only touches the two cpu columns
+        unsigned char *b = (unsigned char *)cap_block(&v, k);
+        long long nrows = (long long)cap_rows(b);
+        const unsigned char *cb = cap_cell(b, COL_CPU_BUSY, 0), *ct = cap_cell(b, COL_CPU_TOTAL, 0);
+        for(long long r=0; r<nrows; r++){
+            sum_busy += get_le64(cb + r * 8);
+            sum_total += get_le64(ct + r * 8);
         }
     }
+    long long scan_ns = now_ns() - start;
 
-    *(prev_cpu_usage) = cur_cpu_usage; //sets the 'prev_cpu_usage' to 'cur_cpu_usage' for later iteration(s)
+    printf("### Benchmark: capture of a week at 1 Hz (%lld samples, %.1f MB, %lld blocks) ###\n", week, v.size / 1048576.0, v.nblocks);
+    printf(" record:             %8.2f ms (%.0f ns/sample)\n", write_ns / 1e6, (double)write_ns / week);
+    printf(" open + seek:        %8.3f ms (row %lld, expected %lld)\n", seek_ns / 1e6, found, week / 2);
+    printf(" one-hour window:    %8.3f ms (%lld samples, mean cpu %.1f%%)\n", window_ns / 1e6, n, n ? (double)busy / n : 0.0);
+    printf(" week cpu scan:      %8.2f ms (mean cpu %.2f%%)\n", scan_ns / 1e6, sum_total ? 100.0 * sum_busy / sum_total : 0.0);
+    munmap((void *)v.map, v.size);
+    unlink(path);
+    return n == hour && found == week / 2 ? 0 : 1;
+}
+
+// runs the micro-benchmark selected with --bench=NAME and returns the exit status of the program
+int run_benchmark(const char *name){
+    if(strcmp(name, "sample") == 0) return bench_sample();
+    if(strcmp(name, "cores") == 0) return bench_cores();
+    if(strcmp(name, "render") == 0) return bench_render();
+    if(strcmp(name, "users") == 0) return bench_users();
+    if(strcmp(name, "top") == 0) return bench_top();
+    if(strcmp(name, "meminfo") == 0) return bench_meminfo();
+    if(strcmp(name, "bars") == 0) return bench_bars();
+    if(strcmp(name, "stages") == 0) return bench_stages();
+    if(strcmp(name, "replay") == 0) return bench_replay();
+
+    fprintf(stderr, "Unknown benchmark '%s' (available: sample, cores, render, users, top, meminfo, bars, stages, replay)\n", name); //prints the list of benchmarks to stderr
+    return 1;
 }
 
 /* Main function, implementing the functionality to display memory, user, cpu usage of the system.
@@ -241,7 +3249,19 @@ void cpu_graphics(char cpuArr[][200], int i, int sequential, int *num_bar, float
 int main(int argc, char *argv[])
 {
     //initializing variables and flags used to control the display of information in the program
-    int i, samples = 10, tdelay = 1, system = 0, user = 0, graphics = 0, sequential = 0, cmd; 
+    long long i;
+    int samples = 10, system = 0, user = 0, graphics = 0, sequential = 0, cmd; 
+    long long interval_ns = 1000000000LL; //time between samples in nanoseconds, 1 second by default
+    int per_core = 0; //flag for printing the usage of every core
+    int top_n = 0; //number of processes in the top-N view, 0 if it is not shown
+    int disk = 0, net = 0; //flags for printing the disk and network throughput
+    const char *bench = NULL; //name of the micro-benchmark to run instead of sampling, if any
+    enum output_format format = FORMAT_TEXT; //how every sample is output
+    const char *decode = NULL; //binary capture to decode instead of sampling, if any
+    const char *record = NULL, *replay = NULL; //columnar capture to append every sample to, or to replay instead of sampling
+    const char *from = NULL, *to = NULL; //window of the replay, the whole capture by default
+    struct capture cap = {.fd = -1}; //the capture being recorded
+    static struct out_stream out; //buffered record stream for the machine-readable formats (static because of its size)
 
     //uses getopt_long to parse the command line options passed to the program
     struct option long_options[] = { //an array of 'struct option' objects, each line representing a single command line option
@@ -251,16 +3271,48 @@ int main(int argc, char *argv[])
         {"sequential", no_argument, 0, 'q'}, //takes "sequential" with no argument, returns 'q' if option is present
         {"samples", optional_argument, 0, 'n'}, //takes "samples" with optional argument, returns 'n' if option is present
         {"tdelay", optional_argument, 0, 't'}, //takes "tdelay" with optional argument, returns 't' if option is present
+        {"per-core", no_argument, 0, 'P'}, //takes "per-core" with no argument, returns 'P' if option is present
+        {"disk", no_argument, 0, 'D'}, //takes "disk" with no argument, returns 'D' if option is present
+        {"net", no_argument, 0, 'N'}, //takes "net" with no argument, returns 'N' if option is present
+        {"top", required_argument, 0, 'T'}, //takes "top" with the number of processes to show, returns 'T' if option is present
+        {"format", required_argument, 0, 'f'}, //takes "format" with text, csv, jsonl or bin, returns 'f' if option is present
+        {"decode", required_argument, 0, 'd'}, //takes "decode" with the path of a binary capture, returns 'd' if option is present
+        {"bar-width", required_argument, 0, 'W'}, //takes "bar-width" with the characters of a full-scale bar, returns 'W' if option is present
+        {"bar-scale", required_argument, 0, 'S'}, //takes "bar-scale" with the factor applied to scaled bars, returns 'S' if option is present
+        {"sparkline", no_argument, 0, 'k'}, //takes "sparkline" with no argument, returns 'k' if option is present
+        {"self-stats", no_argument, 0, 'R'}, //takes "self-stats" with no argument, returns 'R' if option is present
+        {"record", required_argument, 0, 'r'}, //takes "record" with the path of a capture to append to, returns 'r' if option is present
+        {"replay", required_argument, 0, 'p'}, //takes "replay" with the path of a capture, returns 'p' if option is present
+        {"from", required_argument, 0, 'F'}, //takes "from" with the start of the replayed window, returns 'F' if option is present
+        {"to", required_argument, 0, 'U'}, //takes "to" with the end of the replayed window, returns 'U' if option is present
+        {"bench", required_argument, 0, 'b'}, //takes "bench" with the name of a micro-benchmark, returns 'b' if option is present
         {0,0,0,0} //indicates the end of options
     };
 
-    double virt_used=0.0, prev_virt=0.00; //declares and initializes variables for virtual current and previous memory usage
-    float cur_cpu_usage=0.00, prev_cpu_usage=0.00; //declares and initializes variables for current and previous cpu usage
-    char strArr[samples][1024]; //a 2D char array for storing memory display information
-    char cpuArr[samples][200]; //a 2D char array for storing cpu display information
-    int num_bar=3; //sets default num of bars for cpu graphics to 3
-    unsigned long curSample[7]; //an unsigned long array of size 7 whose user, nice, system, idle, iowait, irq, softirq fields of cpu information in /proc/stat sampled at current time.
-    unsigned long prevSample[7]; //an unsigned long array of size 7 whose user, nice, system, idle, iowait, irq, softirq fields of cpu information in /proc/stat sampled at an earlier time.
+    float cur_cpu_usage=0.00; //declares and initializes the variable for current cpu usage
+    int base_usage=0; //integer part of the cpu usage of the first sample, the reference for the number of cpu bars
+    struct sample_ring history; //the latest samples as raw numbers, rendered only for the rows on screen
+    struct sample cur; //the sample being assembled from the snapshots of the collectors
+    struct sample last_mem; //latest memory snapshot received
+    struct meminfo last_info; //the /proc/meminfo fields of last_mem
+    struct cpu_snapshot prevSnap = {0}; //latest cpu snapshot consumed, copied out of its queue slot; the previous sample of the next delta
+    int have_prev = 0; //whether prevSnap holds a snapshot yet
+    int show_report = 0; //whether the frame ends with the --self-stats report, toggled by SIGUSR1 in text mode
+    struct session_list *sessions = NULL; //latest session snapshot, kept in its queue slot until a newer one arrives
+    struct top_snapshot *top = NULL; //latest top-N snapshot, kept in its queue slot until a newer one arrives
+    double *coreUsage = NULL; //usage of every row of prevSnap.table, computed by cpu_usage_kernel
+    int core_ok = 0; //whether coreUsage matches the latest snapshot (the number of cores may change between snapshots)
+    long long skipped = 0; //samples that were never drawn because the renderer was behind
+    sem_t ready; //counts the cpu snapshots published but not consumed yet
+
+    //the collectors: one thread per source, each publishing into its own lock-free queue
+    struct collector cpu_col = {.name = "cpu", .stage = STAGE_CPU, .sample = sample_cpu, .release = release_cpu, .slot_size = sizeof(struct cpu_snapshot)};
+    struct collector mem_col = {.name = "memory", .stage = STAGE_MEMORY, .sample = sample_memory, .slot_size = sizeof(struct mem_snapshot)};
+    struct collector ses_col = {.name = "sessions", .stage = STAGE_UTMP, .sample = sample_sessions, .release = release_sessions, .slot_size = sizeof(struct session_list)};
+    struct collector top_col = {.name = "top", .stage = STAGE_TOP, .sample = sample_top, .release = release_top, .slot_size = sizeof(struct top_snapshot)};
+    struct collector disk_col = {.name = "disk", .stage = STAGE_DISK, .sample = sample_disk, .slot_size = sizeof(struct io_snapshot)};
+    struct collector net_col = {.name = "net", .stage = STAGE_NET, .sample = sample_net, .slot_size = sizeof(struct io_snapshot)};
+    static struct io_view disk_view, net_view; //static because of the size of the snapshot copies
 
     //retrieves and processes command line options passed to the program using the 'getopt_long' function
     // stored in argv array, and returns the next option found in the argument list
@@ -288,8 +3340,76 @@ int main(int argc, char *argv[])
                 if (optarg) samples = atoi(optarg);
                 break;
             case 't':
-                //in case cmd is 't', if option has an argument, atoi converts the argument from string to integer and updates the value of tdelay 
-                if (optarg) tdelay = atoi(optarg); 
+                //in case cmd is 't', if option has an argument, parse_interval converts the seconds or milliseconds into nanoseconds
+                if (optarg && (interval_ns = parse_interval(optarg)) < 0){
+                    fprintf(stderr, "Invalid tdelay '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T':
+                top_n = atoi(optarg); //in case cmd is 'T', atoi converts the number of processes to show
+                if(top_n <= 0){
+                    fprintf(stderr, "Invalid top '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'D':
+                disk = 1; //in case cmd is 'D', 'disk' is set to 1
+                break;
+            case 'N':
+                net = 1; //in case cmd is 'N', 'net' is set to 1
+                break;
+            case 'P':
+                per_core = 1; //in case cmd is 'P', 'per_core' is set to 1
+                break;
+            case 'f':
+                //in case cmd is 'f', parse_format converts the name of the format, and unknown names are rejected
+            {
+                int f = parse_format(optarg); //parsed into an int first, since -1 is not a value of the enum
+                if (f < 0){
+                    fprintf(stderr, "Invalid format '%s' (available: text, csv, jsonl, bin)\n", optarg);
+                    return 1;
+                }
+                format = (enum output_format)f;
+                break;
+            }
+            case 'd':
+                decode = optarg; //in case cmd is 'd', the path of the capture is stored and decoded after option parsing
+                break;
+            case 'W':
+                bars.width = atoi(optarg); //in case cmd is 'W', atoi converts the width of a full-scale bar
+                if(bars.width <= 0 || bars.width > BAR_MAX){
+                    fprintf(stderr, "Invalid bar-width '%s' (1 to %d)\n", optarg, BAR_MAX);
+                    return 1;
+                }
+                break;
+            case 'S':
+                bars.scale = strtod(optarg, NULL); //in case cmd is 'S', the factor is converted from the string
+                if(!(bars.scale > 0)){
+                    fprintf(stderr, "Invalid bar-scale '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                bars.spark = 1; //in case cmd is 'k', charts are drawn as sparklines
+                break;
+            case 'R':
+                self_stats = 1; //in case cmd is 'R', every stage is timed
+                break;
+            case 'r':
+                record = optarg; //in case cmd is 'r', the path of the capture is stored and opened before sampling starts
+                break;
+            case 'p':
+                replay = optarg; //in case cmd is 'p', the path of the capture is stored and replayed after option parsing
+                break;
+            case 'F':
+                from = optarg; //in case cmd is 'F', the start of the window is parsed once the capture is open
+                break;
+            case 'U':
+                to = optarg; //in case cmd is 'U', same for the end of the window
+                break;
+            case 'b':
+                bench = optarg; //in case cmd is 'b', the name of the benchmark is stored and run after option parsing
                 break;
         }
 
@@ -305,54 +3425,251 @@ int main(int argc, char *argv[])
                 samples = atoi(argv[ind]); //if iter is 0, then samples gets updated with the integer represenation of the string argument
                 break;
             case 1:
-                tdelay = atoi(argv[ind]); //if iter is 1, then tdelay gets updated with the integer representation of the string argument
+                if((interval_ns = parse_interval(argv[ind])) < 0){ //if iter is 1, then the interval gets updated from the string argument
+                    fprintf(stderr, "Invalid tdelay '%s'\n", argv[ind]);
+                    return 1;
+                }
                 break;
         }
         //the use of iter maintains the order and functionality of the postional arguments
     }
 
-    for (i = 0; i < samples; i++) { // iterate through the number of samples
-        set_cpu_values(prevSample); //setting cpu values of 'prevSample'
-        sleep(tdelay); //cause delay for tdelay seconds for sampling frequency
+    if(bench) return run_benchmark(bench); //runs only the requested benchmark when --bench is given
+    if(decode) return decode_capture(decode, format); //replays a binary capture as csv or jsonl when --decode is given
+    if(replay) return replay_capture(replay, format, from, to, graphics, sequential); //re-renders or re-exports a recorded window
+
+    if(samples < 0){ //--samples=0 means continuous monitoring, negative counts are rejected
+        fprintf(stderr, "Invalid number of samples %d\n", samples);
+        return 1;
+    }
+
+    //the history keeps one row per sample up to HISTORY_MAX - 1 rows, so memory use does not grow with --samples
+    int rows = history_rows(samples, graphics);
+    if(ring_init(&history, rows + 1) < 0){
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    term.mode = sequential ? SCREEN_APPEND : SCREEN_DIFF; //sequential output is appended, otherwise the frame is updated in place
+    out.fd = STDOUT_FILENO;
+    out.last_flush = now_ns();
+    encode_header(&out, format); //csv column names or the binary file header
+    if(record && capture_open(&cap, record, interval_ns) < 0) return 1; //every sample is also appended to the capture
+
+    struct sigaction sa; //Ctrl-C ends the loop instead of killing the program, so the summary is still printed
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if(self_stats){ //without --self-stats, SIGUSR1 keeps its default action
+        sa.sa_handler = request_report; //SIGUSR1 prints the --self-stats report so far
+        sigaction(SIGUSR1, &sa, NULL);
+    }
+    if(format == FORMAT_TEXT && !sequential){
+        sa.sa_handler = note_resize; //SIGWINCH makes the next frame a full redraw at the new size
+        sigaction(SIGWINCH, &sa, NULL);
+    }
+    sa.sa_handler = wake_thread; //SIGUSR2 only interrupts the sleep of a collector thread when the pipeline stops
+    sigaction(SIGUSR2, &sa, NULL);
+
+    //which collectors run: cpu paces the renderer, memory is part of every sample, sessions are only needed on screen
+    int show_users = format == FORMAT_TEXT && (user || !system);
+    int show_top = format == FORMAT_TEXT && top_n > 0 && (!user || system);
+    int show_disk = format == FORMAT_TEXT && disk && (!user || system);
+    int show_net = format == FORMAT_TEXT && net && (!user || system);
+    top_col.top_n = top_n;
+    if(show_top && proc_scanner_init(&top_scanner, "/proc") < 0){
+        fprintf(stderr, "Could not open /proc\n");
+        return 1;
+    }
+    cpu_col.per_core = per_core;
+    cpu_col.limit = samples ? samples + 1 : 0; //snapshot 0 is only the starting point of the first interval
+    cpu_col.ready = &ready;
+    sem_init(&ready, 0, 0);
+    write_memory(&last_mem, &last_info); //a first memory reading in case the memory collector has not published yet
+
+    sigset_t block, old; //the collector threads inherit a mask without SIGINT/SIGTERM so those are delivered to the renderer
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    long long start = now_ns(); //all collectors tick at start + k * interval
+    self_start_ns = start;
+    if(collector_start(&cpu_col, interval_ns, start) < 0 || collector_start(&mem_col, interval_ns, start) < 0 ||
+        (show_users && collector_start(&ses_col, interval_ns, start) < 0) || (show_top && collector_start(&top_col, interval_ns, start) < 0) ||
+        (show_disk && collector_start(&disk_col, interval_ns, start) < 0) || (show_net && collector_start(&net_col, interval_ns, start) < 0)){
+        fprintf(stderr, "Could not start the collector threads\n");
+        return 1;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    for (i = 0; (samples == 0 || i < samples) && !stop_requested; ) { // iterate through the number of samples, or forever in continuous mode
+        if(report_requested){ //SIGUSR1
+            report_requested = 0;
+            if(format == FORMAT_TEXT) show_report = !show_report; //on screen, the report becomes part of the frame until the next SIGUSR1
+            else print_self_stats(stderr); //stdout holds the records, so the report goes to stderr
+        }
+        if(sem_wait(&ready) < 0) continue; //interrupted by a signal, the loop condition checks stop_requested
+        long long render_start = self_stats ? raw_ns() : 0; //the renderer's work for this wake-up is the render stage
+
+        //consumes every cpu snapshot available, so a slow frame never makes the collectors wait
+        long long first = i;
+        struct cpu_snapshot *cs;
+        while((samples == 0 || i < samples) && (cs = spsc_peek(&cpu_col.queue, 0)) != NULL){
+            if(have_prev){
+                struct mem_snapshot *ms;
+                while((ms = spsc_peek(&mem_col.queue, 0)) != NULL && ms->tick <= cs->tick){ //the latest memory snapshot not newer than this cpu snapshot
+                    last_mem = ms->mem;
+                    last_info = ms->info;
+                    spsc_pop(&mem_col.queue);
+                }
+
+                cur = last_mem;
+                cur.t_ns = cs->t_ns;
+                cur.wall_ns = cs->wall_ns;
+                set_cpu_delta(prevSnap.agg, cs->agg, &cur); //stores the raw cpu time deltas of this interval
+                cur_cpu_usage = calculate_cpu_usage(prevSnap.agg, cs->agg); //calculates and assigns 'cur_cpu_usage' based on the previous and current snapshots
+                ring_push(&history, &cur); //the record becomes sample number i of the history
+                if(i == 0) base_usage = (int)cur_cpu_usage;
+
+                if(format != FORMAT_TEXT) encode_sample(&out, format, i, &cur); //machine-readable formats stream every sample
+                if(cap.fd >= 0 && capture_append(&cap, &cur) < 0){
+                    fprintf(stderr, "Could not write the capture %s, recording stopped\n", record);
+                    capture_close(&cap);
+                }
+
+                core_ok = per_core && cpu_table_same_rows(&prevSnap.table, &cs->table); //skips the per-core view if a core went on- or offline in between, even if the count is the same
+                if(core_ok){
+                    double *bigger = realloc(coreUsage, cs->table.n * sizeof *coreUsage);
+                    if(bigger == NULL){
+                        fprintf(stderr, "Out of memory\n");
+                        exit(1);
+                    }
+                    coreUsage = bigger;
+                    cpu_usage_kernel(&prevSnap.table, &cs->table, coreUsage, cs->table.n); //computes the usage of all cores in one pass
+                }
+                i++;
+            }
+
+            //the snapshot becomes the previous one; it is copied because the collector reuses the slot after spsc_pop
+            memcpy(prevSnap.agg, cs->agg, sizeof prevSnap.agg);
+            if(per_core) cpu_table_copy(&prevSnap.table, &cs->table);
+            have_prev = 1;
+            spsc_pop(&cpu_col.queue);
+        }
+        if(i == first) continue; //only the starting snapshot arrived
+
+        if(format != FORMAT_TEXT){
+            stream_tick(&out, now_ns());
+            if(self_stats) hist_record(&stage_hist[STAGE_RENDER], raw_ns() - render_start);
+            if(out.error) break; //the records cannot be written, e.g. the disk is full or the reader is gone
+            continue;
+        }
+        skipped += i - first - 1; //only the latest of the samples consumed together is drawn
+
+        if(show_users){ //frees the older session snapshots and keeps the latest one
+            while(spsc_peek(&ses_col.queue, 1) != NULL) spsc_pop(&ses_col.queue);
+            sessions = spsc_peek(&ses_col.queue, 0);
+        }
+        if(show_top){ //same for the top-N snapshots
+            while(spsc_peek(&top_col.queue, 1) != NULL) spsc_pop(&top_col.queue);
+            top = spsc_peek(&top_col.queue, 0);
+        }
+        if(show_disk) io_view_update(&disk_view, &disk_col.queue); //the I/O views keep copies of the two latest snapshots
+        if(show_net) io_view_update(&net_view, &net_col.queue);
 
-        display_header(i, sequential, samples, tdelay); //displays header information
+        display_header(i - 1, sequential, samples, interval_ns / 1e9); //displays header information
         if(!user || (user && system)){ //runs so long as the argument doesn't contain just '--user'
-            printf("---------------------------------------\n");
-            virt_used = write_memory(strArr, i); //updates strArr at index i and returns virt_used memory
+            frame_printf("---------------------------------------\n");
 
-            if(graphics) 
-                modify_memory_graphics(i, virt_used, &prev_virt, strArr); //modify strArr graphically if graphics is an option
-            
-            display_memory_line(sequential, samples, i, strArr); //displays lines of memory information according to sequential and strArr
+            display_memory_line(sequential, rows, i - 1, &history, graphics); //displays the memory rows of the history window, graphically if graphics is an option
+            print_meminfo(&last_info, graphics, bars.width ? bars.width : 40); //breakdown of the latest reading, with a used/cache/free bar if graphics is an option
             
             if((user && system)||!system){ //prints users if user and system are both options and skips if system option was given without user
-                printf("---------------------------------------\n");
-                print_users(); //prints current user information on server
-                printf("---------------------------------------\n");
+                frame_printf("---------------------------------------\n");
+                print_users(sessions); //prints current user information on server
+                frame_printf("---------------------------------------\n");
             }
 
             print_cores(); //print the number of cores
-            
-            set_cpu_values(curSample); //samples current cpu information 'curSample'
+            frame_printf(" total cpu use: %.2f%%\n", cur_cpu_usage); //prints current cpu usage upto 2 decimal places
 
-            cur_cpu_usage = calculate_cpu_usage(prevSample, curSample); //calculates and assigns 'cur_cpu_usage' based on 'prevSample' and 'curSample'
-            printf(" total cpu use: %.2f%%\n", cur_cpu_usage); //prints current cpu usage upto 2 decimal places
+            if(core_ok) print_per_core(&prevSnap.table, coreUsage);
 
             if(graphics)
-                cpu_graphics(cpuArr, i, sequential, &num_bar, cur_cpu_usage, &prev_cpu_usage); //if graphics option is given, display cpu graphics
+                cpu_graphics(&history, i - 1, sequential, rows, base_usage); //if graphics option is given, display cpu graphics
+
+            if(show_disk){
+                frame_printf("---------------------------------------\n");
+                print_io(&disk_view, "Disk I/O", "read", "write", "IOPS", graphics); //prints the throughput of every block device
+            }
+            if(show_net){
+                frame_printf("---------------------------------------\n");
+                print_io(&net_view, "Network", "rx", "tx", "pkt/s", graphics); //prints the throughput of every interface
+            }
+
+            if(show_top && top){
+                frame_printf("---------------------------------------\n");
+                print_top(top->e, top->n, top->nprocs); //prints the processes using the most cpu
+            }
         
         }else{ //runs when only user option is given
-            printf("---------------------------------------\n");
-            print_users();
-            printf("---------------------------------------\n");
+            frame_printf("---------------------------------------\n");
+            print_users(sessions);
+            frame_printf("---------------------------------------\n");
+        }
+        if(show_report){ //drawn inside the frame, since text written to the terminal behind the renderer's back garbles the screen
+            frame_printf("---------------------------------------\n");
+            print_self_stats(NULL);
         }
+        screen_flush(&term); //puts the frame on the terminal with a single write
+        if(self_stats) hist_record(&stage_hist[STAGE_RENDER], raw_ns() - render_start);
     }
 
-    printf("---------------------------------------\n");
-    print_machine_info(); //prints machine information all the time at the end
-    printf("---------------------------------------\n");
+    stop_requested = 1; //stops the collectors that have no limit
+    collector_stop(&cpu_col);
+    collector_stop(&mem_col);
+    if(show_users) collector_stop(&ses_col);
+    if(show_top) collector_stop(&top_col);
+    if(show_disk) collector_stop(&disk_col);
+    if(show_net) collector_stop(&net_col);
+    sem_destroy(&ready);
 
-    return 0;
+    FILE *summary = stdout;
+    if(format != FORMAT_TEXT){
+        if(stream_flush(&out) < 0) //writes out the records still buffered
+            fprintf(stderr, "Could not write the records: %s, sampling stopped\n", strerror(out.error));
+        summary = stderr; //the summary goes to stderr so it does not corrupt the record stream
+    } else {
+        printf("---------------------------------------\n");
+        print_machine_info(); //prints machine information all the time at the end
+        printf("---------------------------------------\n");
+    }
+    fprintf(summary, "### Sampling jitter ###\n"); //prints how accurately each collector kept its schedule
+    print_tick_stats(summary, cpu_col.name, &cpu_col.sched, atomic_load(&cpu_col.dropped));
+    print_tick_stats(summary, mem_col.name, &mem_col.sched, atomic_load(&mem_col.dropped));
+    if(show_users) print_tick_stats(summary, ses_col.name, &ses_col.sched, atomic_load(&ses_col.dropped));
+    if(show_top) print_tick_stats(summary, top_col.name, &top_col.sched, atomic_load(&top_col.dropped));
+    if(show_disk) print_tick_stats(summary, disk_col.name, &disk_col.sched, atomic_load(&disk_col.dropped));
+    if(show_net) print_tick_stats(summary, net_col.name, &net_col.sched, atomic_load(&net_col.dropped));
+    if(format == FORMAT_TEXT) fprintf(summary, " samples not drawn: %lld\n", skipped);
+    fprintf(summary, "---------------------------------------\n");
+    if(self_stats){
+        print_self_stats(summary); //what each stage and the whole program cost
+        fprintf(summary, "---------------------------------------\n");
+    }
+
+    ring_free(&history);
+    screen_free(&term);
+    cpu_table_free(&prevSnap.table);
+    free(coreUsage);
+    free(utmp_cache.list.s);
+    if(show_top) proc_scanner_free(&top_scanner);
+    proc_close(&proc_stat);
+    capture_close(&cap);
+
+    return out.error ? 1 : 0; //records that could not be written are a failure
 
     
 }
\ No newline at end of file